@@ -9,10 +9,10 @@ namespace alufix::constSwaps {
 		return ((s & 0xFF) << 8) | s >> 8;
 	}
 	constexpr inline uint32_t bswap32(uint32_t i) {
-		return (bswap16((i & 0xffff)) << 16) | bswap16(i >> 16);
+		return (uint32_t(bswap16(i & 0xffff)) << 16) | bswap16(i >> 16);
 	}
 	constexpr inline uint64_t bswap64(uint64_t l) {
-		return (bswap32((l & 0xffffffff) << 32)) | bswap32(l >> 32);
+		return (uint64_t(bswap32(l & 0xffffffff)) << 32) | bswap32(l >> 32);
 	}
 }
 
@@ -56,6 +56,46 @@ namespace alufix {
 	auto memmove = memcpy;
 #endif
 
+	/**
+	 * Conversion kernels, for when the width is known at compile time.
+	 * Values only ever move through memcpy and shifts, so neither pointer needs to be aligned,
+	 * and the compiler folds each kernel down to a load, maybe a bswap, and a store
+	 */
+
+	/**
+	 * Copies an N byte integer from its ALU representation to a machine representation
+	 * @tparam ENDIANESS the endianness of the machine
+	 * @tparam N the width of the integer in bytes
+	 * @param aluPtr the source ALU representation, sizeof(ALUType<N>) bytes
+	 * @param machinePtr the machine destination, N bytes
+	 */
+	template<endian ENDIANESS, std::size_t N>
+	inline void toDeviceFormat(void *aluPtr, uint8_t *machinePtr) {
+		ALUType<N> value;
+		memcpy(&value, aluPtr, sizeof(value));
+		for(std::size_t i = 0; i < N; i++) {
+			std::size_t shift = ENDIANESS == endian::big ? 8 * (N - 1 - i) : 8 * i;
+			machinePtr[i] = uint8_t(value >> shift);
+		}
+	}
+	/**
+	 * Copies an N byte integer from its machine representation to its ALU representation.
+	 * The two may be the same memory
+	 * @tparam ENDIANESS the endianness of the machine
+	 * @tparam N the width of the integer in bytes
+	 * @param aluPtr the ALU destination, sizeof(ALUType<N>) bytes
+	 * @param machinePtr the machine source, N bytes
+	 */
+	template<endian ENDIANESS, std::size_t N>
+	inline void toLocalALUFormat(uint8_t *aluPtr, uint8_t *machinePtr) {
+		ALUType<N> value = 0;
+		for(std::size_t i = 0; i < N; i++) {
+			std::size_t shift = ENDIANESS == endian::big ? 8 * (N - 1 - i) : 8 * i;
+			value |= ALUType<N>(machinePtr[i]) << shift;
+		}
+		memcpy(aluPtr, &value, sizeof(value));
+	}
+
 	/**
 	 * Swapping routines
 	 */
@@ -69,18 +109,19 @@ namespace alufix {
 			}
 		}
 		else {
+			auto *dest = reinterpret_cast<uint8_t *>(destPtr);
 			switch (size) {
 			case 1:
-				*reinterpret_cast<uint8_t *>(destPtr) = *reinterpret_cast<uint8_t *>(srcPtr);
+				*dest = *reinterpret_cast<uint8_t *>(srcPtr);
 				break;
 			case 2:
-				*reinterpret_cast<uint16_t *>(destPtr) = bswap16(*static_cast<uint16_t *>(srcPtr));
+				toDeviceFormat<ENDIANESS, 2>(srcPtr, dest);
 				break;
 			case 4:
-				*reinterpret_cast<uint32_t *>(destPtr) = bswap32(*static_cast<uint32_t *>(srcPtr));
+				toDeviceFormat<ENDIANESS, 4>(srcPtr, dest);
 				break;
 			case 8:
-				*reinterpret_cast<uint64_t *>(destPtr) = bswap64(*static_cast<uint64_t *>(srcPtr));
+				toDeviceFormat<ENDIANESS, 8>(srcPtr, dest);
 			default:
 				break;
 			}
@@ -97,20 +138,20 @@ namespace alufix {
 	 */
 	template<endian ENDIANESS>
 	inline void toDeviceFormat(void *aluPtr, uint8_t *machinePtr, std::size_t size) {
-		if(size == 3) {
-			auto src = *static_cast<uint32_t*>(aluPtr);
-			if constexpr (ENDIANESS == endian::big) {
-				machinePtr[0] = (src >> 16) & 0xFF;
-				machinePtr[1] = (src >> 8) & 0xFF;
-				machinePtr[2] = src & 0xFF;
-			}
-			else {
-				machinePtr[2] = (src >> 16) & 0xFF;
-				machinePtr[1] = (src >> 8) & 0xFF;
-				machinePtr[0] = src & 0xFF;
-			}
-		}
-		else {
+		switch(size) {
+		case 3:
+			toDeviceFormat<ENDIANESS, 3>(aluPtr, machinePtr);
+			break;
+		case 5:
+			toDeviceFormat<ENDIANESS, 5>(aluPtr, machinePtr);
+			break;
+		case 6:
+			toDeviceFormat<ENDIANESS, 6>(aluPtr, machinePtr);
+			break;
+		case 7:
+			toDeviceFormat<ENDIANESS, 7>(aluPtr, machinePtr);
+			break;
+		default:
 			swapBytes<ENDIANESS>(aluPtr, machinePtr, size);
 		}
 	}
@@ -125,16 +166,20 @@ namespace alufix {
 	 */
 	template<endian ENDIANESS>
 	inline void toLocalALUFormat(uint8_t *aluPtr, uint8_t *machinePtr, std::size_t size) {
-		if(size == 3) {
-			auto alu = reinterpret_cast<uint32_t*>(aluPtr);
-			if constexpr (ENDIANESS == endian::big) {
-				*alu = (machinePtr[0] << 16) + (machinePtr[1] << 8) + machinePtr[2];
-			}
-			else {
-				*alu = (machinePtr[2] << 16) + (machinePtr[1] << 8) + machinePtr[0];
-			}
-		}
-		else {
+		switch(size) {
+		case 3:
+			toLocalALUFormat<ENDIANESS, 3>(aluPtr, machinePtr);
+			break;
+		case 5:
+			toLocalALUFormat<ENDIANESS, 5>(aluPtr, machinePtr);
+			break;
+		case 6:
+			toLocalALUFormat<ENDIANESS, 6>(aluPtr, machinePtr);
+			break;
+		case 7:
+			toLocalALUFormat<ENDIANESS, 7>(aluPtr, machinePtr);
+			break;
+		default:
 			swapBytes<ENDIANESS>(machinePtr, aluPtr, size);
 		}
 	}
@@ -161,7 +206,7 @@ namespace alufix {
 			value = constSwaps::bswap32(value);
 		}
 		else if constexpr (N == 8) {
-			value = constSwaps::bswap64;
+			value = constSwaps::bswap64(value);
 		}
 	}
 }
\ No newline at end of file
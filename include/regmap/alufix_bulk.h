@@ -0,0 +1,237 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include "alufix.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define ALUFIX_X86_SIMD 1
+#include <immintrin.h>
+#endif
+
+/*
+ * Bulk conversions, for arrays of samples like the contents of a sensor's FIFO.
+ * On x86 these pick SSSE3 or AVX2 shuffles at runtime, and fall back to the scalar
+ * kernels everywhere else. Neither pointer needs to be aligned
+ */
+namespace alufix::bulk {
+	namespace detail {
+		template<endian ENDIANESS, std::size_t N, typename T>
+		inline void toLocalScalar(T *dest, uint8_t *src, std::size_t count) {
+			for(std::size_t i = 0; i < count; i++) {
+				ALUType<N> value;
+				toLocalALUFormat<ENDIANESS, N>(reinterpret_cast<uint8_t*>(&value), src + i * N);
+				if constexpr (std::is_signed_v<T> && N * 8 < sizeof(T) * 8) {
+					// move the sign bit to the top, then shift it back down arithmetically
+					constexpr std::size_t SPARE = sizeof(T) * 8 - N * 8;
+					dest[i] = T(value << SPARE) >> SPARE;
+				}
+				else {
+					dest[i] = T(value);
+				}
+			}
+		}
+
+#ifdef ALUFIX_X86_SIMD
+		/*
+		 * Shuffle masks reversing every N byte word in a 16 byte lane
+		 */
+		template<std::size_t N>
+		__attribute__((target("ssse3")))
+		inline __m128i swapMask() {
+			alignas(16) int8_t mask[16];
+			for(int i = 0; i < 16; i++) {
+				mask[i] = int8_t(i - i % N + (N - 1 - i % N));
+			}
+			return _mm_load_si128(reinterpret_cast<__m128i*>(mask));
+		}
+		/*
+		 * Shuffle mask spreading 4 packed 24-bit samples into the top of 4 32-bit lanes,
+		 * so shifting right by 8 sign or zero extends them
+		 */
+		template<endian ENDIANESS>
+		__attribute__((target("ssse3")))
+		inline __m128i spreadMask24() {
+			alignas(16) int8_t mask[16];
+			for(int k = 0; k < 4; k++) {
+				mask[4 * k] = -1; // zeroes the byte
+				for(int b = 0; b < 3; b++) {
+					mask[4 * k + 1 + b] = int8_t(ENDIANESS == endian::big ? 3 * k + 2 - b : 3 * k + b);
+				}
+			}
+			return _mm_load_si128(reinterpret_cast<__m128i*>(mask));
+		}
+
+		template<std::size_t N>
+		__attribute__((target("ssse3")))
+		inline std::size_t swapSSSE3(uint8_t *dest, uint8_t *src, std::size_t count) {
+			constexpr std::size_t PER_VECTOR = 16 / N;
+			const __m128i mask = swapMask<N>();
+			std::size_t i = 0;
+			for(; i + PER_VECTOR <= count; i += PER_VECTOR) {
+				__m128i v = _mm_loadu_si128(reinterpret_cast<__m128i*>(src + i * N));
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * N), _mm_shuffle_epi8(v, mask));
+			}
+			return i;
+		}
+		template<std::size_t N>
+		__attribute__((target("avx2")))
+		inline std::size_t swapAVX2(uint8_t *dest, uint8_t *src, std::size_t count) {
+			constexpr std::size_t PER_VECTOR = 32 / N;
+			const __m128i lane = swapMask<N>();
+			const __m256i mask = _mm256_inserti128_si256(_mm256_castsi128_si256(lane), lane, 1);
+			std::size_t i = 0;
+			for(; i + PER_VECTOR <= count; i += PER_VECTOR) {
+				__m256i v = _mm256_loadu_si256(reinterpret_cast<__m256i*>(src + i * N));
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i * N), _mm256_shuffle_epi8(v, mask));
+			}
+			return i;
+		}
+
+		template<endian ENDIANESS, bool SIGNED>
+		__attribute__((target("ssse3")))
+		inline std::size_t spread24SSSE3(uint8_t *dest, uint8_t *src, std::size_t count) {
+			const __m128i mask = spreadMask24<ENDIANESS>();
+			std::size_t i = 0;
+			// every load takes 16 bytes, but only consumes 12 of them
+			for(; i + 6 <= count; i += 4) {
+				__m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<__m128i*>(src + i * 3)), mask);
+				v = SIGNED ? _mm_srai_epi32(v, 8) : _mm_srli_epi32(v, 8);
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i * 4), v);
+			}
+			return i;
+		}
+		template<endian ENDIANESS, bool SIGNED>
+		__attribute__((target("avx2")))
+		inline std::size_t spread24AVX2(uint8_t *dest, uint8_t *src, std::size_t count) {
+			const __m128i lane = spreadMask24<ENDIANESS>();
+			const __m256i mask = _mm256_inserti128_si256(_mm256_castsi128_si256(lane), lane, 1);
+			std::size_t i = 0;
+			// each half takes 16 bytes, but only consumes 12 of them
+			for(; i + 10 <= count; i += 8) {
+				__m128i lo = _mm_loadu_si128(reinterpret_cast<__m128i*>(src + i * 3));
+				__m128i hi = _mm_loadu_si128(reinterpret_cast<__m128i*>(src + i * 3 + 12));
+				__m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+				v = _mm256_shuffle_epi8(v, mask);
+				v = SIGNED ? _mm256_srai_epi32(v, 8) : _mm256_srli_epi32(v, 8);
+				_mm256_storeu_si256(reinterpret_cast<__m256i*>(dest + i * 4), v);
+			}
+			return i;
+		}
+
+		inline bool hasAVX2() {
+			return __builtin_cpu_supports("avx2");
+		}
+		inline bool hasSSSE3() {
+			return __builtin_cpu_supports("ssse3");
+		}
+#endif
+
+		/*
+		 * Byte swaps (or copies, for native data) count N byte words.
+		 * Returns how many were handled with SIMD
+		 */
+		template<endian ENDIANESS, std::size_t N>
+		inline std::size_t swapVector(uint8_t *dest, uint8_t *src, std::size_t count) {
+			if constexpr (ENDIANESS == endian::native) {
+				if(dest != src) {
+					memcpy(dest, src, count * N);
+				}
+				return count;
+			}
+#ifdef ALUFIX_X86_SIMD
+			else if(hasAVX2()) {
+				return swapAVX2<N>(dest, src, count);
+			}
+			else if(hasSSSE3()) {
+				return swapSSSE3<N>(dest, src, count);
+			}
+#endif
+			else {
+				return 0;
+			}
+		}
+	}
+
+	/**
+	 * Converts an array of 16-bit samples from the device's format
+	 * @tparam ENDIANESS the endianness of the device
+	 * @param dest where to store the samples
+	 * @param src the samples as they came off the bus, 2 bytes each
+	 * @param count the number of samples
+	 */
+	template<endian ENDIANESS>
+	inline void toLocal16(uint16_t *dest, uint8_t *src, std::size_t count) {
+		auto *destPtr = reinterpret_cast<uint8_t*>(dest);
+		std::size_t done = detail::swapVector<ENDIANESS, 2>(destPtr, src, count);
+		detail::toLocalScalar<ENDIANESS, 2>(dest + done, src + done * 2, count - done);
+	}
+	/**
+	 * Converts an array of 32-bit samples from the device's format
+	 * @tparam ENDIANESS the endianness of the device
+	 * @param dest where to store the samples
+	 * @param src the samples as they came off the bus, 4 bytes each
+	 * @param count the number of samples
+	 */
+	template<endian ENDIANESS>
+	inline void toLocal32(uint32_t *dest, uint8_t *src, std::size_t count) {
+		auto *destPtr = reinterpret_cast<uint8_t*>(dest);
+		std::size_t done = detail::swapVector<ENDIANESS, 4>(destPtr, src, count);
+		detail::toLocalScalar<ENDIANESS, 4>(dest + done, src + done * 4, count - done);
+	}
+	/**
+	 * Unpacks an array of 24-bit samples from the device's format into 32-bit integers
+	 * @tparam ENDIANESS the endianness of the device
+	 * @tparam T int32_t to sign extend the samples, uint32_t to zero extend them
+	 * @param dest where to store the samples. It may only overlap src if src starts count bytes
+	 * into it, which is how samples are decoded in place
+	 * @param src the samples as they came off the bus, 3 bytes each
+	 * @param count the number of samples
+	 */
+	template<endian ENDIANESS, typename T>
+	inline void toLocal24(T *dest, uint8_t *src, std::size_t count) {
+		static_assert(std::is_same_v<T, int32_t> || std::is_same_v<T, uint32_t>,
+			"24-bit samples unpack into int32_t or uint32_t");
+		std::size_t done = 0;
+#ifdef ALUFIX_X86_SIMD
+		constexpr bool SIGNED = std::is_signed_v<T>;
+		auto *destPtr = reinterpret_cast<uint8_t*>(dest);
+		if(detail::hasAVX2()) {
+			done = detail::spread24AVX2<ENDIANESS, SIGNED>(destPtr, src, count);
+		}
+		else if(detail::hasSSSE3()) {
+			done = detail::spread24SSSE3<ENDIANESS, SIGNED>(destPtr, src, count);
+		}
+#endif
+		detail::toLocalScalar<ENDIANESS, 3>(dest + done, src + done * 3, count - done);
+	}
+	/**
+	 * Converts an array of N byte samples from the device's format, picking the fastest
+	 * conversion for the width. Decodes in place if src starts count * (sizeof(ALUType<N>) - N)
+	 * bytes into dest
+	 * @tparam ENDIANESS the endianness of the device
+	 * @tparam N the width of each sample on the bus
+	 * @param dest where to store the samples
+	 * @param src the samples as they came off the bus, N bytes each
+	 * @param count the number of samples
+	 */
+	template<endian ENDIANESS, std::size_t N>
+	inline void toLocal(ALUType<N> *dest, uint8_t *src, std::size_t count) {
+		if constexpr (N == 2) {
+			toLocal16<ENDIANESS>(dest, src, count);
+		}
+		else if constexpr (N == 3) {
+			toLocal24<ENDIANESS>(dest, src, count);
+		}
+		else if constexpr (N == 4) {
+			toLocal32<ENDIANESS>(dest, src, count);
+		}
+		else if constexpr (N == 1 || (N == 8 && ENDIANESS == endian::native)) {
+			if(reinterpret_cast<uint8_t*>(dest) != src) {
+				memcpy(dest, src, count * N);
+			}
+		}
+		else {
+			detail::toLocalScalar<ENDIANESS, N>(dest, src, count);
+		}
+	}
+}
@@ -21,12 +21,31 @@ namespace alufix::types {
 		using type = uint32_t;
 	};
 	template<>
+	struct ALUTypeImpl<5> {
+		using type = uint64_t;
+	};
+	template<>
+	struct ALUTypeImpl<6> {
+		using type = uint64_t;
+	};
+	template<>
+	struct ALUTypeImpl<7> {
+		using type = uint64_t;
+	};
+	template<>
 	struct ALUTypeImpl<8> {
 		using type = uint64_t;
 	};
 	template<std::size_t SIZE>
 	using ALUType = typename ALUTypeImpl<SIZE>::type;
 
+	/**
+	 * The size of the ALU type holding a SIZE byte integer, for when SIZE is only known at runtime
+	 */
+	constexpr std::size_t aluSize(std::size_t size) {
+		return size <= 2 ? size : size <= 4 ? 4 : 8;
+	}
+
 	/**
 	 * Comment this out as soon as C++20's new endian stuff is stable:
 	 * 	https://en.cppreference.com/w/cpp/types/endian
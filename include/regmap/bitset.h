@@ -23,4 +23,7 @@ namespace regmap {
 	inline void bitset_set(REGMAP_BACKING_TYPE *bitset, unsigned  int bit) {
 		bitset[bit / INT_SIZE] |= 1 << (bit % INT_SIZE);
 	}
+	inline void bitset_clear(REGMAP_BACKING_TYPE *bitset, unsigned  int bit) {
+		bitset[bit / INT_SIZE] &= ~(1 << (bit % INT_SIZE));
+	}
 }
\ No newline at end of file
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include "register_utils.h"
+#include "utils.h"
+
+namespace regmap::burst {
+	/**
+	 * Where a register lives on the bus, and where it was in the caller's argument list
+	 */
+	struct Span {
+		std::size_t addr;
+		std::size_t width;
+		std::size_t arg;
+	};
+	/**
+	 * A run of address-contiguous registers that can be moved in a single transaction
+	 */
+	struct Run {
+		std::size_t addr;
+		std::size_t width; // total bytes in the run
+		std::size_t first; // the first span of the run
+		std::size_t count; // the number of spans in the run
+	};
+	/**
+	 * A burst plan, built at compile time
+	 * @tparam N the number of registers in the plan
+	 */
+	template<std::size_t N>
+	struct Plan {
+		Span spans[N];
+		Run runs[N];
+		std::size_t numRuns;
+		std::size_t maxRunWidth;
+		bool overlaps;
+	};
+
+	/**
+	 * Sorts the registers by address, then merges contiguous addresses into runs
+	 * @tparam MAX the largest run width allowed
+	 * @tparam REGS the registers to plan for
+	 */
+	template<std::size_t MAX, typename... REGS>
+	constexpr Plan<sizeof...(REGS)> plan() {
+		constexpr std::size_t N = sizeof...(REGS);
+		Plan<N> p{};
+		const std::size_t addrs[] = {RegAddr<REGS>()...};
+		const std::size_t widths[] = {RegWidth<REGS>()...};
+		// insertion sort, N is tiny
+		for(std::size_t i = 0; i < N; i++) {
+			Span s{addrs[i], widths[i], i};
+			std::size_t j = i;
+			while(j > 0 && p.spans[j - 1].addr > s.addr) {
+				p.spans[j] = p.spans[j - 1];
+				j--;
+			}
+			p.spans[j] = s;
+		}
+		// merge adjacent spans into runs
+		for(std::size_t i = 0; i < N; i++) {
+			const Span &s = p.spans[i];
+			if(p.numRuns > 0) {
+				Run &last = p.runs[p.numRuns - 1];
+				if(s.addr < last.addr + last.width) {
+					p.overlaps = true;
+				}
+				if(s.addr == last.addr + last.width && last.width + s.width <= MAX) {
+					last.width += s.width;
+					last.count++;
+					if(last.width > p.maxRunWidth) {
+						p.maxRunWidth = last.width;
+					}
+					continue;
+				}
+			}
+			p.runs[p.numRuns++] = Run{s.addr, s.width, i, 1};
+			if(s.width > p.maxRunWidth) {
+				p.maxRunWidth = s.width;
+			}
+		}
+		return p;
+	}
+	template<std::size_t MAX, typename ...REGS>
+	constexpr Plan<sizeof...(REGS)> plan(utils::TypeList<REGS...>) {
+		return plan<MAX, REGS...>();
+	}
+}
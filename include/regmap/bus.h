@@ -0,0 +1,44 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * The bus a register map talks through.
+ *
+ * Every bus provides contiguous transfers:
+ *     int deviceRead(REG_ADDR addr, uint8_t *dest, uint8_t num);
+ *     int deviceWrite(REG_ADDR addr, uint8_t *src, uint8_t num);
+ *
+ * Buses that can chain descriptors (DMA, SPI controllers with scatter-gather lists...) can
+ * also provide vectored transfers, which BasicRegmap will use for everything instead:
+ *     int deviceReadv(const bus::Segment *segments, std::size_t count);
+ *     int deviceWritev(const bus::Segment *segments, std::size_t count);
+ * segments[0] is the address phase, with the address already in the device's byte order.
+ * The rest are the data phase, back to back in address order. Data segments aren't capped
+ * at 255 bytes, so vectored buses get bursts as long as the registers allow.
+ *
+ * Buses that need outgoing data in particular memory (DMA-capable RAM, a peripheral FIFO...)
+ * can provide their own transfer buffer:
+ *     uint8_t *transferBuffer(std::size_t len);
+ * which must return at least len bytes, valid until the next write. Outgoing registers are
+ * packed straight into it instead of into a temporary on the stack.
+ * All of these return negative on error.
+ */
+namespace regmap::bus {
+	/**
+	 * One piece of a transfer
+	 */
+	struct Segment {
+		uint8_t *data;
+		std::size_t len;
+	};
+
+	/**
+	 * The largest transfer deviceRead/deviceWrite can carry
+	 */
+	static constexpr std::size_t MAX_CONTIGUOUS = UINT8_MAX;
+	/**
+	 * The largest transfer deviceReadv/deviceWritev can carry
+	 */
+	static constexpr std::size_t MAX_VECTORED = SIZE_MAX;
+}
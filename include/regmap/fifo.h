@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+
+namespace regmap::fifo {
+	/**
+	 * A ring buffer over caller-owned storage, which Regmap::drainFifo fills
+	 * @tparam T the type of each element, usually RegType<FIFO_REG>
+	 */
+	template<typename T>
+	struct Ring {
+		T *data;
+		std::size_t capacity;
+		std::size_t tail = 0; // the oldest element
+		std::size_t size = 0; // the number of elements stored
+
+		// a ring with no capacity is always full, so nothing is ever drained into it
+		Ring(T *data, std::size_t capacity): data(data), capacity(capacity) {}
+		template<std::size_t N>
+		explicit Ring(T (&storage)[N]): Ring(storage, N) {
+			static_assert(N > 0, "A ring needs room for at least one element");
+		}
+
+		// where the next element goes
+		std::size_t head() const {
+			return wrap(tail + size);
+		}
+		std::size_t space() const {
+			return capacity - size;
+		}
+		// free elements from head() before the storage wraps around
+		std::size_t contiguousSpace() const {
+			std::size_t h = head();
+			return h >= tail && size < capacity ? capacity - h : space();
+		}
+		T& operator[](std::size_t idx) {
+			return data[wrap(tail + idx)];
+		}
+		/**
+		 * Marks num elements past head() as stored
+		 */
+		void push(std::size_t num) {
+			size += num;
+		}
+		/**
+		 * Drops the num oldest elements
+		 */
+		void pop(std::size_t num) {
+			tail = wrap(tail + num);
+			size -= num;
+		}
+	private:
+		// indices never go past twice the capacity, so this never divides (by 0 or otherwise)
+		std::size_t wrap(std::size_t idx) const {
+			return idx >= capacity ? idx - capacity : idx;
+		}
+	};
+}
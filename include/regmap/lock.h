@@ -0,0 +1,109 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include "policy.h"
+
+/*
+ * Locking policies. Every lock is split into stripes, and each register
+ * address maps onto a stripe. Operations lock every stripe they touch,
+ * always in ascending order so they can't deadlock each other.
+ */
+namespace regmap::policy {
+	struct LockPolicy: Policy {};
+
+	// a bitmask of stripes
+	using StripeSet = uint32_t;
+
+	/**
+	 * No synchronization at all. Compiles out completely
+	 */
+	struct NoLock: LockPolicy {
+		static constexpr StripeSet ALL_STRIPES = 1;
+		static constexpr StripeSet stripeOf(std::size_t addr) { return 1; }
+
+		void lockStripes(StripeSet stripes) {}
+		void unlockStripes(StripeSet stripes) {}
+	};
+
+	/**
+	 * A single mutex serializing the whole bus
+	 * @tparam MUTEX anything with lock() and unlock(), like std::mutex
+	 */
+	template<typename MUTEX>
+	struct BusLock: LockPolicy {
+		static constexpr StripeSet ALL_STRIPES = 1;
+		static constexpr StripeSet stripeOf(std::size_t addr) { return 1; }
+
+		MUTEX busMutex;
+
+		void lockStripes(StripeSet stripes) {
+			busMutex.lock();
+		}
+		void unlockStripes(StripeSet stripes) {
+			busMutex.unlock();
+		}
+	};
+
+	/**
+	 * Spinlocks striped by register address, so threads touching different
+	 * registers don't wait on each other. Only use this if your bus can
+	 * handle concurrent transactions
+	 * @tparam NUM_STRIPES the number of spinlocks, at most 32
+	 */
+	template<std::size_t NUM_STRIPES>
+	struct StripedLock: LockPolicy {
+		static_assert(NUM_STRIPES > 0 && NUM_STRIPES <= sizeof(StripeSet) * 8,
+			"StripedLock supports between 1 and 32 stripes");
+		static constexpr StripeSet ALL_STRIPES = StripeSet(~StripeSet(0)) >> (sizeof(StripeSet) * 8 - NUM_STRIPES);
+		static constexpr StripeSet stripeOf(std::size_t addr) {
+			return StripeSet(1) << (addr % NUM_STRIPES);
+		}
+
+		std::atomic<bool> spinlocks[NUM_STRIPES] = {};
+
+		void lockStripes(StripeSet stripes) {
+			for(std::size_t i = 0; i < NUM_STRIPES; i++) {
+				if(stripes & (StripeSet(1) << i)) {
+					// test-and-test-and-set, so waiters don't hammer the cache line
+					while(spinlocks[i].exchange(true, std::memory_order_acquire)) {
+						while(spinlocks[i].load(std::memory_order_relaxed)) {}
+					}
+				}
+			}
+		}
+		void unlockStripes(StripeSet stripes) {
+			for(std::size_t i = NUM_STRIPES; i > 0; i--) {
+				if(stripes & (StripeSet(1) << (i - 1))) {
+					spinlocks[i - 1].store(false, std::memory_order_release);
+				}
+			}
+		}
+	};
+
+	template<typename T>
+	using IsLock = std::is_base_of<LockPolicy, T>;
+	/**
+	 * The lock in a list of registers/policies
+	 */
+	template<typename ...ITEMS>
+	using LockOf = typename utils::Find<IsLock, NoLock, ITEMS...>::type;
+
+	/**
+	 * Holds stripes of a lock for as long as it lives
+	 */
+	template<typename LOCK>
+	class LockGuard {
+	public:
+		LockGuard(LOCK &lock, StripeSet stripes): lock(lock), stripes(stripes) {
+			lock.lockStripes(stripes);
+		}
+		~LockGuard() {
+			lock.unlockStripes(stripes);
+		}
+		LockGuard(const LockGuard&) = delete;
+		LockGuard& operator=(const LockGuard&) = delete;
+	private:
+		LOCK &lock;
+		StripeSet stripes;
+	};
+}
@@ -1,11 +1,52 @@
 #pragma once
 #include "register.h"
 #include "register_utils.h"
+#include <atomic>
+#include <cstddef>
 #include <cstdint>
 #include <type_traits>
 #include "bitset.h"
+#include "policy.h"
+
+namespace regmap {
+	/**
+	 * Memoizes a register for a limited time, for registers that change slowly.
+	 * Needs a policy::Clock in the Regmap
+	 * @tparam REG the register to memoize
+	 * @tparam TTL how many clock ticks the memoized value stays valid for
+	 */
+	template<typename REG, std::size_t TTL>
+	struct Ttl: REG {
+		static_assert(TTL > 0, "A TTL of 0 is the same as not memoizing");
+		using Cached = REG;
+		static constexpr std::size_t TimeToLive = TTL;
+	};
+}
 
 namespace regmap::memoizer {
+	// the register being memoized, without any Ttl wrapper
+	template<typename T, typename = void>
+	struct CachedImpl {
+		using type = T;
+	};
+	template<typename T>
+	struct CachedImpl<T, std::void_t<typename T::Cached>> {
+		using type = typename T::Cached;
+	};
+	template<typename T>
+	using Cached = typename CachedImpl<T>::type;
+
+	// how long a memoized register lives for, 0 is forever
+	template<typename T>
+	constexpr std::size_t ttlOf() {
+		if constexpr (std::is_same_v<Cached<T>, T>) {
+			return 0;
+		}
+		else {
+			return T::TimeToLive;
+		}
+	}
+
 	// fwd declaration
 	template<std::size_t IDX, typename... REGS>
 	struct MemoHolder;
@@ -16,17 +57,14 @@ namespace regmap::memoizer {
 		RegType<HEAD> value;
 		MemoHolder<IDX + 1, REST...> rest;
 
-		constexpr void* getPtr(std::size_t idx) {
-			if (idx == IDX) {
-				return (void*)&value;
+		template<std::size_t I>
+		constexpr auto& get() {
+			if constexpr (I == IDX) {
+				return value;
 			}
-			return rest.getPtr(idx);
-		}
-		constexpr std::size_t getIdx(std::size_t addr) {
-			if (addr == RegAddr<HEAD>()) {
-				return IDX;
+			else {
+				return rest.template get<I>();
 			}
-			return rest.getIdx(addr);
 		}
 	};
 
@@ -35,56 +73,514 @@ namespace regmap::memoizer {
 	struct MemoHolder<IDX, HEAD> {
 		RegType<HEAD> value;
 
-		constexpr void* getPtr(std::size_t idx) {
-			if (idx == IDX) {
-				return reinterpret_cast<void*>(&value);
+		template<std::size_t I>
+		constexpr auto& get() {
+			static_assert(I == IDX, "Memo slot out of range");
+			return value;
+		}
+	};
+
+	/*
+	 * Address -> memo slot lookups, generated at compile time
+	 */
+	// address spaces smaller than this get a dense lookup table
+	static constexpr std::size_t DENSE_INDEX_LIMIT = 256;
+
+	// with the default uint16_t, invalidateAll() is O(1) except once every 65535 calls, when
+	// the epoch wraps around and every slot is cleared. Define REGMAP_EPOCH_TYPE as uint32_t
+	// for devices that get reset in a tight loop, or as uint8_t to save a byte per slot
+#ifndef REGMAP_EPOCH_TYPE
+#define REGMAP_EPOCH_TYPE uint16_t
+#endif
+
+	// the smallest type that can hold every slot, plus the "not memoized" slot
+	template<std::size_t N>
+	using SlotType = typename utils::TypeTernary<(N < UINT8_MAX), uint8_t, uint16_t>::type;
+
+	// a loop rather than utils::maximum, which recurses once per register
+	template<typename ...REGS>
+	constexpr std::size_t maxAddr() {
+		const std::size_t addrs[] = {RegAddr<REGS>()...};
+		std::size_t max = 0;
+		for(std::size_t addr: addrs) {
+			max = addr > max ? addr : max;
+		}
+		return max;
+	}
+
+	// O(1): a table indexed by address
+	template<typename ...REGS>
+	struct DenseIndex {
+		static constexpr std::size_t N = sizeof...(REGS);
+		static constexpr std::size_t MAX_ADDR = maxAddr<REGS...>();
+		struct Table {
+			SlotType<N> slots[MAX_ADDR + 1];
+		};
+		static constexpr Table build() {
+			Table t{};
+			const std::size_t addrs[] = {RegAddr<REGS>()...};
+			for(std::size_t addr = 0; addr <= MAX_ADDR; addr++) {
+				t.slots[addr] = N;
+			}
+			// the first register at an address wins, like slotOf
+			for(std::size_t i = N; i > 0; i--) {
+				t.slots[addrs[i - 1]] = i - 1;
 			}
-			return nullptr;
+			return t;
 		}
-		constexpr std::size_t getIdx(std::size_t addr) {
-			if (addr == RegAddr<HEAD>()) {
-				return IDX;
+		static constexpr Table TABLE = build();
+
+		static constexpr std::size_t lookup(uint64_t key) {
+			return key <= MAX_ADDR ? TABLE.slots[key] : N;
+		}
+	};
+
+	// O(log N): a binary search over the sorted keys (see RegKey), so it also tells pages apart
+	template<typename ...REGS>
+	struct SortedIndex {
+		static constexpr std::size_t N = sizeof...(REGS);
+		struct Table {
+			uint64_t keys[N];
+			std::size_t slots[N];
+		};
+		static constexpr Table build() {
+			Table t{};
+			const uint64_t keys[] = {RegKey<REGS>()...};
+			// insertion sort, N is tiny. Equal keys stay in order, so the first one wins like slotOf
+			for(std::size_t i = 0; i < N; i++) {
+				std::size_t j = i;
+				while(j > 0 && t.keys[j - 1] > keys[i]) {
+					t.keys[j] = t.keys[j - 1];
+					t.slots[j] = t.slots[j - 1];
+					j--;
+				}
+				t.keys[j] = keys[i];
+				t.slots[j] = i;
 			}
-			return IDX + 1;
+			return t;
+		}
+		static constexpr Table TABLE = build();
+
+		static constexpr std::size_t lookup(uint64_t key) {
+			std::size_t low = 0;
+			std::size_t high = N;
+			while(low < high) {
+				std::size_t mid = low + (high - low) / 2;
+				if(TABLE.keys[mid] < key) {
+					low = mid + 1;
+				}
+				else {
+					high = mid;
+				}
+			}
+			if(low < N && TABLE.keys[low] == key) {
+				return TABLE.slots[low];
+			}
+			return N;
 		}
 	};
+
+	// paged registers always get a SortedIndex, since their keys are huge
+	template<typename ...REGS>
+	using AddrIndex = typename utils::TypeTernary<(maxAddr<REGS...>() < DENSE_INDEX_LIMIT
+		&& !(isPaged<REGS>() || ...)), DenseIndex<REGS...>, SortedIndex<REGS...>>::type;
+
 	// zero-memoizer. Everything is constexpr return false
 	struct ZeroMemoizer {
-		constexpr void* getPtr(std::size_t addr) { return nullptr; }
+		constexpr void* getPtr(std::size_t idx) { return nullptr; }
 		constexpr std::size_t getIdx(std::size_t addr) { return 0; }
 
 		// the following methods take in indices, not addresses
 		constexpr bool isMemoized(std::size_t idx) { return false; }
 		constexpr bool isSeen(std::size_t idx) { return false; }
-		void setSeen(std::size_t idx) {};
+		constexpr bool isKnown(std::size_t idx, uint64_t bits) { return false; }
+		constexpr bool isDirty(std::size_t idx) { return false; }
+		constexpr bool matches(std::size_t idx, void *src, std::size_t num) { return false; }
+		void update(std::size_t idx, void *src, std::size_t num, bool dirty = false) {};
+		void invalidate(std::size_t idx) {};
+		void invalidateBits(std::size_t idx, uint64_t bits) {};
+		void invalidateAll() {};
+
+		struct Snapshot {};
+		void save(Snapshot &snap) {};
 	};
-	// N-memoizer. We actually have to implement stuff :(
+	// timestamps of the Ttl registers
+	template<typename TICK, std::size_t NUM_TTL>
+	struct Stamps {
+		TICK stamps[NUM_TTL] = {0};
+	};
+	template<typename TICK>
+	struct Stamps<TICK, 0> {};
+
+	// sequence counters for lock-free reads. Odd while a slot is being written
+	template<std::size_t N, bool ENABLED>
+	struct Sequences {
+		std::atomic<uint32_t> seqs[N] = {};
+
+		void beginWrite(std::size_t idx) {
+			seqs[idx].store(seqs[idx].load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+		}
+		void endWrite(std::size_t idx) {
+			seqs[idx].store(seqs[idx].load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+	};
+	template<std::size_t N>
+	struct Sequences<N, false> {
+		void beginWrite(std::size_t idx) {}
+		void endWrite(std::size_t idx) {}
+	};
+
+	// the bits of each slot that were forgotten since it was last stamped, with policy::FieldValidity
+	template<std::size_t N, bool ENABLED>
+	struct Unknowns {
+		uint64_t unknown[N] = {0};
+	};
+	template<std::size_t N>
+	struct Unknowns<N, false> {};
+
+#ifdef __GNUC__
+	static constexpr bool HAS_ATOMIC_BUILTINS = true;
+#else
+	static constexpr bool HAS_ATOMIC_BUILTINS = false;
+#endif
+
 	template<typename ...REGS>
-	struct NMemoizer {
+	constexpr std::size_t countTtl() {
+		return (std::size_t(0) + ... + (ttlOf<REGS>() > 0));
+	}
+
+	// N-memoizer. We actually have to implement stuff :(
+	template<typename CLOCK, bool SEQLOCK, bool FIELDS, typename ...REGS>
+	struct BasicMemoizer: Stamps<decltype(CLOCK::now()), countTtl<REGS...>()>,
+		Sequences<sizeof...(REGS), SEQLOCK>, Unknowns<sizeof...(REGS), FIELDS> {
+		using Tick = decltype(CLOCK::now());
 		static constexpr std::size_t NUM_MEMOIZED = sizeof...(REGS);
+		static constexpr std::size_t NUM_TTL = countTtl<REGS...>();
+		static_assert(NUM_TTL == 0 || !std::is_same_v<CLOCK, policy::NoClock>,
+			"Ttl registers need a policy::Clock");
+		static_assert(!SEQLOCK || HAS_ATOMIC_BUILTINS,
+			"policy::SeqlockReads needs a compiler with __atomic builtins");
+		static_assert((isCacheable<REGS>() && ...),
+			"W1C and clear-on-read registers change whenever they're accessed, so they cannot be memoized");
+
+		// per slot: its lifetime, and where its timestamp lives
+		struct TtlTable {
+			std::size_t ttl[NUM_MEMOIZED];
+			std::size_t stamp[NUM_MEMOIZED];
+		};
+		static constexpr TtlTable buildTtls() {
+			TtlTable t{};
+			const std::size_t ttls[] = {ttlOf<REGS>()...};
+			std::size_t stamp = 0;
+			for(std::size_t i = 0; i < NUM_MEMOIZED; i++) {
+				t.ttl[i] = ttls[i];
+				t.stamp[i] = ttls[i] > 0 ? stamp++ : 0;
+			}
+			return t;
+		}
+		static constexpr TtlTable TTLS = buildTtls();
+		struct Offsets {
+			std::size_t offsets[NUM_MEMOIZED];
+		};
+		/*
+		 * Lays MemoHolder out the way the compiler does, from the innermost holder outwards:
+		 * each holder's rest starts at the first suitably aligned byte after its value.
+		 * Loops instead of recursing, so big maps stay under the constexpr depth limit
+		 */
+		static constexpr std::size_t alignUp(std::size_t n, std::size_t align) {
+			return (n + align - 1) / align * align;
+		}
+		struct Layout {
+			Offsets offsets;
+			std::size_t size;
+		};
+		static constexpr Layout buildLayout() {
+			const std::size_t sizes[] = {sizeof(RegType<REGS>)...};
+			const std::size_t aligns[] = {alignof(RegType<REGS>)...};
+			std::size_t restOffsets[NUM_MEMOIZED] = {};
+			std::size_t size = sizes[NUM_MEMOIZED - 1];
+			std::size_t align = aligns[NUM_MEMOIZED - 1];
+			for(std::size_t i = NUM_MEMOIZED - 1; i > 0; i--) {
+				std::size_t outer = aligns[i - 1] > align ? aligns[i - 1] : align;
+				restOffsets[i - 1] = alignUp(sizes[i - 1], align);
+				size = alignUp(restOffsets[i - 1] + size, outer);
+				align = outer;
+			}
+			Layout l{};
+			for(std::size_t i = 1; i < NUM_MEMOIZED; i++) {
+				l.offsets.offsets[i] = l.offsets.offsets[i - 1] + restOffsets[i - 1];
+			}
+			l.size = size;
+			return l;
+		}
+		static constexpr Layout LAYOUT = buildLayout();
+		static_assert(LAYOUT.size == sizeof(MemoHolder<0, REGS...>), "MemoHolder isn't laid out as expected");
+		static constexpr Offsets OFFSETS = LAYOUT.offsets;
+
+		/**
+		 * A copy of every memoized value, and whether it was valid
+		 */
+		struct Snapshot {
+			MemoHolder<0, REGS...> memos;
+			bitset<NUM_MEMOIZED> valid = {0};
+
+			void* getPtr(std::size_t idx) {
+				return reinterpret_cast<uint8_t*>(&memos) + OFFSETS.offsets[idx];
+			}
+			bool isValid(std::size_t idx) const {
+				return bitset_test(valid, idx);
+			}
+		};
+
 		MemoHolder<0, REGS...> memos;
-		bitset<NUM_MEMOIZED> regSeen = {0};
+		// a slot is seen if it was stamped during the current epoch. 0 is never a valid epoch
+		REGMAP_EPOCH_TYPE epoch = 1;
+		REGMAP_EPOCH_TYPE regSeen[NUM_MEMOIZED] = {0};
+		// only used in write-back mode. One byte per slot, so registers on different lock stripes never share a word
+		bool regDirty[NUM_MEMOIZED] = {false};
 
+		// paged registers are keyed by their page too, so addresses alone never reach them
 		constexpr std::size_t getIdx(std::size_t addr) {
-			return memos.getIdx(addr);
+			return AddrIndex<REGS...>::lookup(MemoKey(addr));
 		}
 
 		// the following methods take in indicies, not addresses
 		constexpr bool isMemoized(std::size_t idx) {
 			return idx < NUM_MEMOIZED;
 		}
+		// dirty registers never expire, or the pending write would be lost
 		bool isSeen(std::size_t idx) {
-			return bitset_test(regSeen, idx);
+			return isKnown(idx, ~uint64_t(0));
+		}
+		// whether some bits of a slot are valid. Without policy::FieldValidity, it's all or nothing
+		bool isKnown(std::size_t idx, uint64_t bits) {
+			if constexpr (FIELDS) {
+				if(load(this->unknown[idx]) & bits) {
+					return false;
+				}
+			}
+			return load(regSeen[idx]) == load(epoch) && (isFresh(idx) || load(regDirty[idx]));
+		}
+		// dirty registers have been seen, but not yet written to the device
+		bool isDirty(std::size_t idx) {
+			return regDirty[idx] && regSeen[idx] == epoch;
+		}
+		// whether a slot holds a valid value equal to the one at src
+		template<std::size_t IDX, typename T>
+		bool matches(const T &value) {
+			return isSeen(IDX) && slot<IDX>() == value;
+		}
+		bool matches(std::size_t idx, void *src, std::size_t num) {
+			if(!isSeen(idx)) {
+				return false;
+			}
+			auto *memo = reinterpret_cast<uint8_t*>(getPtr(idx));
+			auto *bytes = reinterpret_cast<uint8_t*>(src);
+			for(std::size_t i = 0; i < alufix::types::aluSize(num); i++) {
+				if(memo[i] != bytes[i]) {
+					return false;
+				}
+			}
+			return true;
+		}
+		/**
+		 * Stores a value into a slot
+		 * @param dirty whether the value still has to be written to the device
+		 */
+		template<std::size_t IDX, typename T>
+		void update(const T &value, bool dirty = false) {
+			this->beginWrite(IDX);
+			store(slot<IDX>(), value);
+			mark(IDX, dirty);
+			this->endWrite(IDX);
+		}
+		void update(std::size_t idx, void *src, std::size_t num, bool dirty = false) {
+			this->beginWrite(idx);
+			void *dest = getPtr(idx);
+			if(dest != src) {
+				storeBytes(dest, src, alufix::types::aluSize(num));
+			}
+			mark(idx, dirty);
+			this->endWrite(idx);
+		}
+		void invalidate(std::size_t idx) {
+			this->beginWrite(idx);
+			store(regSeen[idx], REGMAP_EPOCH_TYPE(0));
+			store(regDirty[idx], false);
+			this->endWrite(idx);
+		}
+		// forgets some bits of a slot. The rest of a pending write-back never reached the device,
+		// so a dirty slot is forgotten entirely, like invalidate()
+		void invalidateBits(std::size_t idx, uint64_t bits) {
+			if(isDirty(idx)) {
+				invalidate(idx);
+				return;
+			}
+			this->beginWrite(idx);
+			if constexpr (FIELDS) {
+				store(this->unknown[idx], this->unknown[idx] | bits);
+			}
+			this->endWrite(idx);
 		}
-		void setSeen(std::size_t idx) {
-			bitset_set(regSeen, idx);
+		// moves onto the next epoch. Only clears the stamps when the epoch wraps around
+		void invalidateAll() {
+			store(epoch, REGMAP_EPOCH_TYPE(epoch + 1));
+			if(epoch == 0) {
+				for(std::size_t i = 0; i < NUM_MEMOIZED; i++) {
+					this->beginWrite(i);
+					store(regSeen[i], REGMAP_EPOCH_TYPE(0));
+					this->endWrite(i);
+				}
+				store(epoch, REGMAP_EPOCH_TYPE(1));
+			}
+		}
+		/**
+		 * Reads a slot without any lock, retrying if a writer gets in the way.
+		 * Only available with policy::SeqlockReads
+		 * @return whether the slot was seen
+		 */
+		template<std::size_t IDX, typename T>
+		bool tryRead(T &dest) {
+			static_assert(SEQLOCK, "Lock-free reads need policy::SeqlockReads");
+			auto &seq = this->seqs[IDX];
+			while(true) {
+				uint32_t before = seq.load(std::memory_order_acquire);
+				if(before & 1) {
+					continue;
+				}
+				bool seen = isSeen(IDX);
+				T value = load(slot<IDX>());
+				std::atomic_thread_fence(std::memory_order_acquire);
+				if(seq.load(std::memory_order_relaxed) == before) {
+					if(seen) {
+						dest = value;
+					}
+					return seen;
+				}
+			}
+		}
+		void* getPtr(std::size_t idx) {
+			if(idx >= NUM_MEMOIZED) {
+				return nullptr;
+			}
+			return reinterpret_cast<uint8_t*>(&memos) + OFFSETS.offsets[idx];
+		}
+		// pending write-back values count as valid, since they're what the device should hold
+		void save(Snapshot &snap) {
+			snap.memos = memos;
+			for(std::size_t i = 0; i < NUM_MEMOIZED; i++) {
+				if(isSeen(i)) {
+					bitset_set(snap.valid, i);
+				}
+				else {
+					bitset_clear(snap.valid, i);
+				}
+			}
 		}
-		constexpr void* getPtr(std::size_t idx) {
-			return memos.getPtr(idx);
+		// direct access to a slot whose index is known at compile time
+		template<std::size_t IDX>
+		constexpr auto& slot() {
+			return memos.template get<IDX>();
+		}
+	private:
+		// the memo matches the device, unless it's dirty
+		void mark(std::size_t idx, bool dirty) {
+			store(regSeen[idx], epoch);
+			store(regDirty[idx], dirty);
+			if constexpr (FIELDS) {
+				store(this->unknown[idx], uint64_t(0));
+			}
+			touch(idx);
+		}
+		bool isFresh(std::size_t idx) {
+			if constexpr (NUM_TTL > 0) {
+				if(TTLS.ttl[idx] > 0) {
+					return Tick(CLOCK::now() - load(this->stamps[TTLS.stamp[idx]])) < TTLS.ttl[idx];
+				}
+			}
+			return true;
+		}
+		// lock-free readers race with writers, so they load everything atomically
+		template<typename T>
+		static T load(const T &value) {
+#ifdef __GNUC__
+			if constexpr (SEQLOCK) {
+				return __atomic_load_n(&value, __ATOMIC_RELAXED);
+			}
+#endif
+			return value;
 		}
+		// ...and writers store it atomically too. Writers are serialized, so they can read plainly
+		template<typename T>
+		static void store(T &dest, T value) {
+#ifdef __GNUC__
+			if constexpr (SEQLOCK) {
+				__atomic_store_n(&dest, value, __ATOMIC_RELAXED);
+				return;
+			}
+#endif
+			dest = value;
+		}
+		// copies size bytes into a slot, which holds an integer of exactly that size
+		static void storeBytes(void *dest, void *src, std::size_t size) {
+			if constexpr (SEQLOCK) {
+				switch(size) {
+				case 1: return storeAs<uint8_t>(dest, src);
+				case 2: return storeAs<uint16_t>(dest, src);
+				case 4: return storeAs<uint32_t>(dest, src);
+				case 8: return storeAs<uint64_t>(dest, src);
+				}
+			}
+			alufix::memcpy(dest, src, size);
+		}
+		template<typename T>
+		static void storeAs(void *dest, void *src) {
+			T value;
+			alufix::memcpy(&value, src, sizeof(T));
+			store(*reinterpret_cast<T*>(dest), value);
+		}
+		void touch(std::size_t idx) {
+			if constexpr (NUM_TTL > 0) {
+				if(TTLS.ttl[idx] > 0) {
+					store(this->stamps[TTLS.stamp[idx]], Tick(CLOCK::now()));
+				}
+			}
+		}
+	};
+
+	template<typename CLOCK, bool SEQLOCK, bool FIELDS, typename LIST>
+	struct BasicMemoizerOf;
+	template<typename CLOCK, bool SEQLOCK, bool FIELDS, typename ...REGS>
+	struct BasicMemoizerOf<CLOCK, SEQLOCK, FIELDS, utils::TypeList<REGS...>> {
+		using type = BasicMemoizer<CLOCK, SEQLOCK, FIELDS, REGS...>;
 	};
+	/**
+	 * A memoizer for the registers in a list of registers/policies
+	 */
+	template<typename ...ITEMS>
+	using NMemoizer = typename BasicMemoizerOf<typename policy::ClockOf<ITEMS...>::type,
+		policy::has<policy::SeqlockReads, ITEMS...>(), policy::has<policy::FieldValidity, ITEMS...>(),
+		policy::Registers<ITEMS...>>::type;
+
+
+	/**
+	 * Finds the memo slot of a register at compile time
+	 * @tparam REG the register to look for
+	 * @return the slot of REG, or the number of memoized registers if it isn't memoized
+	 */
+	template<typename REG, typename ...REGS>
+	constexpr std::size_t slotOf(utils::TypeList<REGS...>) {
+		constexpr bool matches[] = {std::is_same_v<REG, Cached<REGS>>..., false};
+		std::size_t idx = 0;
+		while(idx < sizeof...(REGS) && !matches[idx]) {
+			idx++;
+		}
+		return idx;
+	}
 
 	// the final memoizer definition
-	template<typename...REGS>
-	using Memoizer = typename utils::TypeTernary<sizeof...(REGS) == 0, ZeroMemoizer, NMemoizer<REGS...>>::type;
+	template<typename...ITEMS>
+	using Memoizer = typename utils::TypeTernary<policy::Registers<ITEMS...>::size == 0,
+		ZeroMemoizer, NMemoizer<ITEMS...>>::type;
 }
\ No newline at end of file
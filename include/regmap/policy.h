@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+#include <type_traits>
+#include "utils.h"
+
+/*
+ * Policies are passed to Regmap alongside the memoized registers:
+ *  Regmap<endian::big, uint8_t, WHOAMI, CTRL, policy::WriteBack>
+ * They are filtered out of the register list at compile time.
+ */
+namespace regmap::policy {
+	/**
+	 * Base of every policy, so we can tell them apart from registers
+	 */
+	struct Policy {};
+
+	template<typename T>
+	using IsPolicy = std::is_base_of<Policy, T>;
+	template<typename T>
+	using IsRegister = std::negation<IsPolicy<T>>;
+
+	/**
+	 * Writes to memoized registers only touch the memo, and are pushed
+	 * to the device on Regmap::flush()
+	 */
+	struct WriteBack: Policy {};
+
+	/**
+	 * Reads of memoized registers never take the lock. They retry instead
+	 * if a writer updated the register in the middle of the read.
+	 * Writers still have to be serialized, by a lock policy or by only writing from one thread
+	 */
+	struct SeqlockReads: Policy {};
+
+	/**
+	 * Writes of a value a memoized register is already known to hold are dropped
+	 * before they reach the bus. Only use this if writing a register has no side effects
+	 */
+	struct ElideNoopWrites: Policy {};
+
+	/**
+	 * Memoized registers are tracked bit by bit instead of as a whole, so invalidating a mask
+	 * only forgets its bits, and masks whose bits are all still known are served from the memo
+	 */
+	struct FieldValidity: Policy {};
+
+	/**
+	 * The monotonic clock used to expire Ttl registers.
+	 * CLOCK needs a static now() that returns an unsigned tick count.
+	 * Ttl lifetimes are measured in the same ticks
+	 */
+	struct ClockPolicy: Policy {};
+	template<typename CLOCK>
+	struct Clock: ClockPolicy {
+		using type = CLOCK;
+	};
+	// the clock used when none is given, Ttl registers will not compile with it
+	struct NoClock {
+		static constexpr uint8_t now() { return 0; }
+	};
+
+	/**
+	 * Whether POLICY is in a list of registers/policies
+	 */
+	template<typename POLICY, typename ...ITEMS>
+	constexpr bool has() {
+		return utils::contains<POLICY, ITEMS...>::value;
+	}
+	/**
+	 * The registers in a list of registers/policies
+	 */
+	template<typename ...ITEMS>
+	using Registers = utils::Filter<IsRegister, ITEMS...>;
+
+	template<typename T>
+	using IsClock = std::is_base_of<ClockPolicy, T>;
+	/**
+	 * The clock in a list of registers/policies
+	 */
+	template<typename ...ITEMS>
+	using ClockOf = typename utils::Find<IsClock, Clock<NoClock>, ITEMS...>::type;
+}
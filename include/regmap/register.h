@@ -10,30 +10,70 @@ namespace regmap {
 	 * Definition for 24-bit integers
 	 */
 	using uint24_t = uint8_t[3];
+	/**
+	 * Definitions for 40, 48 and 56-bit integers, like timestamp counters
+	 */
+	using uint40_t = uint8_t[5];
+	using uint48_t = uint8_t[6];
+	using uint56_t = uint8_t[7];
+
+	/**
+	 * How a register behaves when it is accessed
+	 */
+	enum class Access {
+		RW,  // read-write
+		RO,  // read-only
+		WO,  // write-only
+		W1C, // writing a 1 to a bit clears it, writing a 0 leaves it alone
+		COR, // clears itself when it is read
+	};
 
 	/**
 	 * Defines a register on a device
 	 * @tparam ADDR the address of the register
 	 * @tparam REG_WIDTH the width of the register
+	 * @tparam ACCESS how the register can be accessed
+	 * @tparam RESET the value the register holds after power-on, if HAS_RESET
+	 * @tparam HAS_RESET whether the datasheet gives the register a reset value
 	 * @tparam REG_TYPE the type of the register. This may not be the same
 	 * as an integer of REG_ADDR_WIDTH in case of 24-bit values
 	 */
-	template<std::size_t ADDR, std::size_t REG_WIDTH>
+	template<std::size_t ADDR, std::size_t REG_WIDTH, Access ACCESS = Access::RW,
+		uint64_t RESET = 0, bool HAS_RESET = false>
 	struct Register {
+		static_assert(REG_WIDTH >= sizeof(uint64_t) || (RESET >> (REG_WIDTH * 8)) == 0,
+			"The reset value doesn't fit in the register");
 		static constexpr std::size_t RegWidth = REG_WIDTH;
 		static constexpr std::size_t addr = ADDR;
+		static constexpr Access access = ACCESS;
+		static constexpr uint64_t resetValue = RESET;
+		static constexpr bool hasReset = HAS_RESET;
 	};
 	/**
-	 * Convenience alias to Register
+	 * Convenience alias to Register. The reset value can be left out
 	 */
-	template<std::size_t ADDR, typename REG_TYPE>
-	using Reg = std::enable_if_t<!std::is_void_v<REG_TYPE>, Register<ADDR, sizeof(REG_TYPE)>>;
+	template<std::size_t ADDR, typename REG_TYPE, Access ACCESS = Access::RW, uint64_t... RESET>
+	using Reg = std::enable_if_t<!std::is_void_v<REG_TYPE> && sizeof...(RESET) <= 1,
+		Register<ADDR, sizeof(REG_TYPE), ACCESS, (uint64_t(0) | ... | RESET), (sizeof...(RESET) > 0)>>;
 
 	template<std::size_t ADDR>
 	using Cmd = Register<ADDR, 0>;
 
 	/**
-	 * Defines a mask of an existing register
+	 * Defines a register behind a page (or bank) select register. Registers on different pages
+	 * can share an address, and still get their own memo slot
+	 * @tparam PAGE_REG the register selecting the page. It must be memoized, so the current page is known
+	 * @tparam PAGE the value PAGE_REG holds while REG is reachable
+	 * @tparam REG the register, as seen once its page is selected
+	 */
+	template<typename PAGE_REG, std::size_t PAGE, typename REG>
+	struct Paged: REG {
+		using PageReg = PAGE_REG;
+		static constexpr std::size_t page = PAGE;
+	};
+
+	/**
+	 * Defines a mask of an existing register. It can be accessed the same way as its register
 	 * @tparam REG The register being masked
 	 * @tparam mask_high The high bit of the mask
 	 * @tparam mask_low The low bit of the mask
@@ -41,11 +81,27 @@ namespace regmap {
 	template<typename REG, uint8_t MASK_HIGH, uint8_t MASK_LOW>
 	struct RegMask {
 		using Reg = REG;
+		static constexpr Access access = REG::access;
 		static constexpr uint8_t MaskHigh = MASK_HIGH;
 		static constexpr uint8_t MaskLow = MASK_LOW;
 	};
+
+	/**
+	 * Defines a group of registers, which are read and written as a unit
+	 * (see GroupType for the struct holding their values)
+	 * @tparam REGS The registers in the group, in any order
+	 */
+	template<typename... REGS>
+	struct RegGroup {
+		static_assert(sizeof...(REGS) > 0, "A group needs at least one register");
+		using Regs = utils::TypeList<REGS...>;
+	};
 }
-#define DECLR_REG( NAME, ADDR, SZ ) using NAME = regmap::Reg<ADDR, SZ>;
+// the access can be left out for read-write registers, eg DECLR_REG(STATUS, 0x10, uint8_t, regmap::Access::COR),
+// and can be followed by a reset value, eg DECLR_REG(CONFIG, 0x11, uint16_t, regmap::Access::RW, 0x0C40)
+#define DECLR_REG( NAME, ADDR, SZ, ... ) using NAME = regmap::Reg<ADDR, SZ, ##__VA_ARGS__>;
 #define DECLR_MASK( NAME, REG, HIGH, LOW ) using NAME = regmap::RegMask<REG, HIGH, LOW>;
 #define DECLR_CMD( NAME, ADDR ) using NAME = regmap::Cmd<ADDR>;
-#define DECLR_BYTE( NAME, ADDR ) using NAME = regmap::Reg<ADDR, uint8_t>;
\ No newline at end of file
+#define DECLR_BYTE( NAME, ADDR, ... ) using NAME = regmap::Reg<ADDR, uint8_t, ##__VA_ARGS__>;
+#define DECLR_GROUP( NAME, ... ) using NAME = regmap::RegGroup<__VA_ARGS__>;
+#define DECLR_PAGED( NAME, PAGE_REG, PAGE, ADDR, SZ, ... ) using NAME = regmap::Paged<PAGE_REG, PAGE, regmap::Reg<ADDR, SZ, ##__VA_ARGS__>>;
\ No newline at end of file
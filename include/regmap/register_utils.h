@@ -14,6 +14,72 @@ namespace regmap {
 	template<typename REG>
 	using RegType = alufix::types::ALUType<REG::RegWidth>; // cannot have intermediate constexpr calls
 
+	/** Access semantics, for registers and masks alike **/
+	template<typename REG>
+	constexpr Access RegAccess() {
+		return REG::access;
+	}
+	template<typename REG>
+	constexpr bool isReadable() {
+		return RegAccess<REG>() != Access::WO;
+	}
+	template<typename REG>
+	constexpr bool isWritable() {
+		return RegAccess<REG>() != Access::RO;
+	}
+	// the device doesn't change the value behind our back when it's accessed, so it can be memoized
+	template<typename REG>
+	constexpr bool isCacheable() {
+		return RegAccess<REG>() != Access::W1C && RegAccess<REG>() != Access::COR;
+	}
+
+
+	/** Pages **/
+	template<typename T, typename = void>
+	struct IsPagedImpl: std::false_type {};
+	template<typename T>
+	struct IsPagedImpl<T, std::void_t<typename T::PageReg>>: std::true_type {};
+	template<typename T>
+	using IsPaged = IsPagedImpl<T>;
+	template<typename REG>
+	constexpr bool isPaged() {
+		return IsPaged<REG>::value;
+	}
+	// whether every paged register in REGS sits on the same page, so they can share a transaction
+	template<typename ...REGS>
+	constexpr bool samePage() {
+		using First = typename utils::Find<IsPaged, void, REGS...>::type;
+		if constexpr (std::is_void_v<First>) {
+			return true;
+		}
+		else {
+			return (([] {
+				if constexpr (isPaged<REGS>()) {
+					return std::is_same_v<typename REGS::PageReg, typename First::PageReg> && REGS::page == First::page;
+				}
+				return true;
+			}()) && ...);
+		}
+	}
+	/**
+	 * The key a register is memoized under: its address, with its page (if any) above it
+	 */
+	constexpr uint64_t MemoKey(std::size_t addr) {
+		return addr;
+	}
+	constexpr uint64_t MemoKey(std::size_t addr, std::size_t page) {
+		return (uint64_t(page + 1) << 32) | addr;
+	}
+	template<typename REG>
+	constexpr uint64_t RegKey() {
+		static_assert(!isPaged<REG>() || uint64_t(RegAddr<REG>()) >> 32 == 0, "Paged registers need 32-bit addresses");
+		if constexpr (isPaged<REG>()) {
+			return MemoKey(RegAddr<REG>(), REG::page);
+		}
+		else {
+			return MemoKey(RegAddr<REG>());
+		}
+	}
 
 	/** Define member accessors for RegMask **/
 	template <typename MASK>
@@ -29,19 +95,98 @@ namespace regmap {
 	template<typename MASK>
 	using MaskType = alufix::types::ALUType<MASK::Reg::RegWidth>; // cannot have intermediate constexpr calls
 
+	// the register of a mask, or the register itself
+	template<typename T, typename = void>
+	struct UnmaskImpl {
+		using type = T;
+	};
+	template<typename T>
+	struct UnmaskImpl<T, std::void_t<typename T::Reg>> {
+		using type = typename T::Reg;
+	};
+	template<typename T>
+	using Unmask = typename UnmaskImpl<T>::type;
+
+	/** Register groups **/
+	// fwd declaration
+	template<typename... REGS>
+	struct GroupData;
+
+	// general case
+	template<typename HEAD, typename... REST>
+	struct GroupData<HEAD, REST...> {
+		RegType<HEAD> value;
+		GroupData<REST...> rest;
+
+		template<typename REG>
+		constexpr auto& get() {
+			if constexpr (std::is_same_v<REG, HEAD>) {
+				return value;
+			}
+			else {
+				return rest.template get<REG>();
+			}
+		}
+	};
+
+	// the 1-reg (tail) case
+	template<typename HEAD>
+	struct GroupData<HEAD> {
+		RegType<HEAD> value;
+
+		template<typename REG>
+		constexpr auto& get() {
+			static_assert(std::is_same_v<REG, HEAD>, "Register isn't in the group");
+			return value;
+		}
+	};
+
+	template<typename GROUP>
+	struct GroupTypeImpl;
+	template<typename... REGS>
+	struct GroupTypeImpl<RegGroup<REGS...>> {
+		using type = GroupData<REGS...>;
+	};
+	/**
+	 * A plain struct holding a value for each register of a group. Use get<REG>() to get at them
+	 */
+	template<typename GROUP>
+	using GroupType = typename GroupTypeImpl<GROUP>::type;
+
 	/** Register mask utilities **/
 	template <typename MASK>
 	constexpr bool MaskSpansRegister() {
-		auto registerWidth = sizeof(MaskType<MASK>);
-		return MaskH<MASK>() == (registerWidth * 8 - 1) && MaskL<MASK>() == 0;
+		return MaskH<MASK>() == (RegWidth<RegOf<MASK>>() * 8 - 1) && MaskL<MASK>() == 0;
 	}
 	template<typename MASK>
 	constexpr MaskType<MASK> bitmask() {
 		using WORD_SZ = MaskType<MASK>;
-		WORD_SZ i = WORD_SZ(); // a safe way to initialize the variable to 0
-		i = ~i; // now flip all the bits before we mask
-		return ~( (WORD_SZ)i << MASK::MaskHigh << 1) & (i << MASK::MaskLow);
+		static_assert(MASK::MaskHigh < sizeof(WORD_SZ) * 8 && MASK::MaskLow <= MASK::MaskHigh,
+			"Mask bits must lie within the register");
+		constexpr std::size_t WIDTH = MASK::MaskHigh - MASK::MaskLow + 1;
+		// shift in the register's own type, and never by its full width
+		constexpr WORD_SZ ones = WIDTH == sizeof(WORD_SZ) * 8 ? WORD_SZ(~WORD_SZ()) : WORD_SZ((WORD_SZ(1) << WIDTH) - 1);
+		return WORD_SZ(ones << MASK::MaskLow);
+	}
+
+	// the bits of REG that any of MASKS cover. Masks of other registers are ignored
+	template<typename REG, typename ...MASKS>
+	constexpr RegType<REG> coveredBits() {
+		return (RegType<REG>(0) | ... | RegType<REG>(std::is_same_v<RegOf<MASKS>, REG> ? bitmask<MASKS>() : 0));
 	}
+	template<typename REG>
+	constexpr RegType<REG> fullBits() {
+		return bitmask<RegMask<REG, RegWidth<REG>() * 8 - 1, 0>>();
+	}
+	// predicate for whether writing MASKS leaves part of a register alone, so it needs a read-modify-write
+	// W1C registers never need one, since writing 0 to the other bits leaves them alone,
+	// and write-only registers take the other bits from their shadow instead
+	template<typename ...MASKS>
+	struct PartiallyMasked {
+		template<typename REG>
+		using pred = std::bool_constant<isReadable<REG>() && RegAccess<REG>() != Access::W1C
+			&& coveredBits<REG, MASKS...>() != fullBits<REG>()>;
+	};
 
 	/** shifting in values to masks **/
 	template<typename MASK>
@@ -1,9 +1,16 @@
 #pragma once
 #include "register.h"
 #include "register_utils.h"
+#include <climits>
 #include <cstdint>
 #include "alufix.h"
+#include "alufix_bulk.h"
 #include "memoizer.h"
+#include "burst.h"
+#include "bus.h"
+#include "policy.h"
+#include "lock.h"
+#include "fifo.h"
 
 namespace regmap {
 	using alufix::endian;
@@ -11,19 +18,37 @@ namespace regmap {
 	using alufix::toDeviceFormat;
 	using alufix::fixEndianness;
 	/**
-	 * An implementation of a register map.
+	 * An implementation of a register map, with the bus resolved at compile time.
+	 * DERIVED must provide deviceRead/deviceWrite with the same signatures as Regmap's,
+	 * either publicly or by befriending BasicRegmap. Nothing is virtual, so transactions
+	 * can inline all the way down into the bus
 	 *
+	 * @tparam DERIVED the class inheriting from this one, which performs the transactions
 	 * @tparam ENDIAN the endianness of the device
 	 * @tparam REG_ADDR the type of each register's address
 	 * @tparam MEMOIZED registers to memoize. Make sure that there are no duplicates in this register!
+	 * Policies (see policy.h) can be mixed into this list as well
 	 */
-	template<endian ENDIAN,
+	template<typename DERIVED,
+		endian ENDIAN,
 		typename REG_ADDR,
 		typename... MEMOIZED>
-	class Regmap {
+	class BasicRegmap: protected policy::LockOf<MEMOIZED...> {
 	public:
 		static constexpr uint8_t REG_ADDR_WIDTH = sizeof(REG_ADDR);
-		memoizer::Memoizer<MEMOIZED...> memoized;
+		// the widest register the endianness conversions handle
+		static constexpr std::size_t MAX_REG_WIDTH = sizeof(uint64_t);
+		static constexpr bool WRITE_BACK = policy::has<policy::WriteBack, MEMOIZED...>();
+		static constexpr bool SEQLOCK_READS = policy::has<policy::SeqlockReads, MEMOIZED...>();
+		static constexpr bool ELIDE_NOOP_WRITES = policy::has<policy::ElideNoopWrites, MEMOIZED...>();
+		static constexpr bool FIELD_VALIDITY = policy::has<policy::FieldValidity, MEMOIZED...>();
+		using MemoizedRegs = policy::Registers<MEMOIZED...>;
+		static constexpr std::size_t NUM_MEMOIZED = MemoizedRegs::size;
+		using Memo = memoizer::Memoizer<MEMOIZED...>;
+		using Snapshot = typename Memo::Snapshot;
+		using Lock = policy::LockOf<MEMOIZED...>;
+		using Guard = policy::LockGuard<Lock>;
+		Memo memoized;
 
 		/**
 		 * Read a register
@@ -33,7 +58,11 @@ namespace regmap {
 		 */
 		template<typename REG>
 		int read(RegType<REG>& dest) {
-			return directRead(RegAddr<REG>(), &dest, RegWidth<REG>());
+			if(tryLockFreeRead<REG>(dest)) {
+				return 0;
+			}
+			Guard guard(*this, stripesOf<REG>());
+			return readReg<REG>(dest);
 		}
 		/**
 		 * Write a register
@@ -43,7 +72,8 @@ namespace regmap {
 		 */
 		template<typename REG>
 		int write(RegType<REG> value) {
-			return directWrite(RegAddr<REG>(), &value, RegWidth<REG>());
+			Guard guard(*this, stripesOf<REG>());
+			return writeReg<REG>(value);
 		}
 		/**
 		 * Writes a command (specialization of register)
@@ -52,7 +82,8 @@ namespace regmap {
 		 */
 		template<typename REG>
 		std::enable_if_t<REG::RegWidth == 0, int> write() {
-			return directWrite(RegAddr<REG>(), nullptr, 0);
+			Guard guard(*this, stripesOf<REG>());
+			return send(RegAddr<REG>(), nullptr, 0);
 		}
 		/**
 		 * Read a register and distribute its value across multiple masks
@@ -67,37 +98,230 @@ namespace regmap {
 			using MergedMask = MergeMasks<MASKS...>;
 			using RegType = MaskType<utils::GetHead<MASKS...>>;
 			RegType regValue;
-			int r = read<RegOf<MergedMask>>(regValue);
-			if(r < 0) {
-				return r;
+			if(!tryLockFreeRead<RegOf<MergedMask>>(regValue)) {
+				Guard guard(*this, stripesOf<RegOf<MergedMask>>());
+				int r = readBits<RegOf<MergedMask>>(regValue, (bitmask<MASKS>() | ...));
+				if(r < 0) {
+					return r;
+				}
 			}
 			distributeMask<RegType, MASKS...>(regValue, values...);
 			return 0;
 		}
 		/**
-		 * Write a register using its component masks
-		 * @tparam HEAD The first mask to write out
-		 * @tparam REST The other masks to write out
-		 * @param headVal The first mask value to write
-		 * @param restVal The other mask values to write
-		 * @return
+		 * Write masks, of one register or several. The masks are grouped by register at compile
+		 * time, registers that are only partly written are read in one coalesced burst,
+		 * and then every register is written back in another. Write-only registers are never
+		 * read: the bits the masks leave alone come from their shadow
+		 * @tparam MASKS The masks to write out, in any order
+		 * @param values The value of each mask
+		 * @return negative on error
 		 */
 		template<typename ...MASKS>
 		int write(MaskType<MASKS>... values) {
-			using MergedMask = MergeMasks<MASKS...>;
-			auto maskedValue = mergeMasks<MASKS...>(values...);
-			// if the new mask spans the whole reg, we don't need the old value
-			if(MaskSpansRegister<MergedMask>()) {
-				return write<RegOf<MergedMask>>(maskedValue);
-			}
-			// otherwise, read in the old value and write out the new one
-			MaskType<MergedMask> newValue;
-			int r = read<RegOf<MergedMask>>(newValue);
+			using Regs = utils::Unique<RegOf<MASKS>...>;
+			utils::Apply<GroupData, Regs> regValues{};
+			Guard guard(*this, stripesOf<MASKS...>());
+			// registers the masks cover completely don't need their old value
+			using PartialRegs = utils::Apply<utils::Unique,
+				utils::Filter<PartiallyMasked<MASKS...>::template pred, RegOf<MASKS>...>>;
+			if(!readKnownBits<MASKS...>(regValues, PartialRegs())) {
+				int r = readGroupRegs(regValues, PartialRegs());
+				if(r < 0) {
+					return r;
+				}
+			}
+			readShadows<MASKS...>(regValues, Regs());
+			((regValues.template get<RegOf<MASKS>>()
+				= applyMask<MASKS>(regValues.template get<RegOf<MASKS>>(), values)), ...);
+			return writeGroupRegs(regValues, Regs());
+		}
+		/**
+		 * Read multiple registers, coalescing adjacent addresses into single transactions
+		 * @tparam REGS The registers to read, in any order
+		 * @param dests The destinations for each register
+		 * @return negative on error
+		 */
+		template<typename ...REGS>
+		int readBlock(RegType<REGS>&... dests) {
+			Guard guard(*this, stripesOf<REGS...>());
+			return readRegs<REGS...>(dests...);
+		}
+		/**
+		 * Write multiple registers, coalescing adjacent addresses into single transactions
+		 * @tparam REGS The registers to write, in any order
+		 * @param values The values to write into each register
+		 * @return negative on error
+		 */
+		template<typename ...REGS>
+		int writeBlock(RegType<REGS>... values) {
+			Guard guard(*this, stripesOf<REGS...>());
+			return writeRegs<REGS...>(values...);
+		}
+		/**
+		 * Read every register of a group in as few transactions as possible
+		 * @tparam GROUP The group to read
+		 * @param dest The struct to store the values in
+		 * @return negative on error
+		 */
+		template<typename GROUP>
+		int read(GroupType<GROUP>& dest) {
+			return readGroup(dest, typename GROUP::Regs());
+		}
+		/**
+		 * Write every register of a group in as few transactions as possible
+		 * @tparam GROUP The group to write
+		 * @param values The values to write
+		 * @return negative on error
+		 */
+		template<typename GROUP>
+		int write(GroupType<GROUP> values) {
+			return writeGroup(values, typename GROUP::Regs());
+		}
+
+		/**
+		 * Drain a FIFO living behind a single register address. Reads the fill level, then pulls
+		 * that many elements (or as many as fit) into the ring in as few bursts as the bus allows,
+		 * decoding them in place. Neither register goes through the memo
+		 * @tparam FIFO_REG The register the FIFO is read through
+		 * @tparam LEVEL The register (or mask) holding the number of elements in the FIFO
+		 * @param ring Where to put the elements
+		 * @return the number of elements drained (at most INT_MAX), or negative on error.
+		 * Elements drained before the error stay in the ring
+		 */
+		template<typename FIFO_REG, typename LEVEL>
+		int drainFifo(fifo::Ring<RegType<FIFO_REG>> &ring) {
+			using LevelReg = Unmask<LEVEL>;
+			using Element = RegType<FIFO_REG>;
+			constexpr std::size_t WIDTH = RegWidth<FIFO_REG>();
+			static_assert(WIDTH > 0, "Commands cannot be read");
+			static_assert(isReadable<FIFO_REG>() && isReadable<LevelReg>(), "Write-only registers cannot be read");
+			static_assert(!isMemoized<FIFO_REG>() && !isMemoized<LevelReg>(),
+				"FIFO registers change under our feet, so they cannot be memoized");
+			Guard guard(*this, stripesOf<FIFO_REG, LevelReg>());
+			RegType<LevelReg> level;
+			int r = fetchReg<LevelReg>(level);
+			if(r < 0) {
+				return r;
+			}
+			if constexpr (!std::is_same_v<LEVEL, LevelReg>) {
+				level = shiftOutValue<LEVEL>(level);
+			}
+			std::size_t pending = level < ring.space() ? level : ring.space();
+			// the count is returned as an int
+			if(pending > std::size_t(INT_MAX)) {
+				pending = INT_MAX;
+			}
+			std::size_t drained = 0;
+			r = selectPage<FIFO_REG>();
 			if(r < 0) {
 				return r;
 			}
-			newValue = applyMask<MergedMask>(newValue, maskedValue);
-			return write<RegOf<MergedMask>>(newValue);
+			while(pending > 0) {
+				std::size_t num = pending < ring.contiguousSpace() ? pending : ring.contiguousSpace();
+				if(num > maxTransfer() / WIDTH) {
+					num = maxTransfer() / WIDTH;
+				}
+				// land the raw elements at the end of their slots, so decoding can expand them forwards
+				Element *dest = ring.data + ring.head();
+				auto *raw = reinterpret_cast<uint8_t*>(dest) + num * (sizeof(Element) - WIDTH);
+				bus::Segment segments[2] = {{}, {raw, num * WIDTH}};
+				r = busRead(RegAddr<FIFO_REG>(), segments, 2, raw);
+				if(r < 0) {
+					return r;
+				}
+				alufix::bulk::toLocal<ENDIAN, WIDTH>(dest, raw, num);
+				ring.push(num);
+				pending -= num;
+				drained += num;
+			}
+			return int(drained);
+		}
+
+		/**
+		 * Push every dirty memoized register out to the device, coalescing
+		 * adjacent addresses into single transactions. Only does anything in write-back mode
+		 * @return negative on error. Registers that failed to write stay dirty
+		 */
+		int flush() {
+			Guard guard(*this, Lock::ALL_STRIPES);
+			if constexpr (WRITE_BACK && NUM_MEMOIZED > 0) {
+				void *memoPtrs[NUM_MEMOIZED];
+				for(std::size_t i = 0; i < NUM_MEMOIZED; i++) {
+					memoPtrs[i] = memoized.getPtr(i);
+				}
+				return pushSlots([this](std::size_t idx) {
+					return memoized.isDirty(idx);
+				}, memoPtrs);
+			}
+			return 0;
+		}
+		/**
+		 * Captures every memoized value, to replay with restore()
+		 */
+		Snapshot snapshot() {
+			Guard guard(*this, Lock::ALL_STRIPES);
+			Snapshot snap;
+			memoized.save(snap);
+			return snap;
+		}
+		/**
+		 * Writes every valid value of a snapshot back to the device in address order,
+		 * coalescing adjacent registers. Read-only registers are skipped. The memo is seeded
+		 * from what was written, and everything else in the memo is forgotten, since this is
+		 * meant for devices that lost their state
+		 * @param snap The snapshot to restore
+		 * @return negative on error
+		 */
+		int restore(Snapshot &snap) {
+			Guard guard(*this, Lock::ALL_STRIPES);
+			memoized.invalidateAll();
+			if constexpr (NUM_MEMOIZED > 0) {
+				void *snapPtrs[NUM_MEMOIZED];
+				for(std::size_t i = 0; i < NUM_MEMOIZED; i++) {
+					snapPtrs[i] = snap.getPtr(i);
+				}
+				return pushSlots([&snap](std::size_t idx) {
+					return snap.isValid(idx);
+				}, snapPtrs);
+			}
+			return 0;
+		}
+
+		/**
+		 * Forget the memoized value of registers, so the next access goes to the device.
+		 * Pending write-back values are dropped too. With policy::FieldValidity, masks only
+		 * forget their own bits, unless their register has a pending write-back
+		 * @tparam REGS The registers (or masks of the registers) to forget
+		 */
+		template<typename ...REGS>
+		void invalidate() {
+			Guard guard(*this, stripesOf<REGS...>());
+			([this] {
+				constexpr std::size_t IDX = memoSlot<Unmask<REGS>>();
+				if constexpr (IDX < NUM_MEMOIZED && FIELD_VALIDITY && !std::is_same_v<REGS, Unmask<REGS>>) {
+					memoized.invalidateBits(IDX, bitmask<REGS>());
+				}
+				else if constexpr (IDX < NUM_MEMOIZED) {
+					memoized.invalidate(IDX);
+				}
+			}(), ...);
+		}
+		/**
+		 * Forget every memoized value, like after a device reset. This is O(1)
+		 */
+		void invalidateAll() {
+			Guard guard(*this, Lock::ALL_STRIPES);
+			memoized.invalidateAll();
+		}
+		/**
+		 * Assume the device was just reset: forget every memoized value, then seed the memo of
+		 * registers with a reset value with it, as if it had been read. Nothing goes over the bus
+		 */
+		void assumeReset() {
+			Guard guard(*this, Lock::ALL_STRIPES);
+			memoized.invalidateAll();
+			seedResets(MemoizedRegs());
 		}
 
 		/**
@@ -106,53 +330,679 @@ namespace regmap {
 		 * @return true if it is memoized
 		 */
 		template<typename REG>
-		bool isMemoized() {
-			return memoized.isMemoized(memoized.getIdx(RegAddr<REG>()));
+		static constexpr bool isMemoized() {
+			return memoSlot<REG>() < NUM_MEMOIZED;
+		}
+		/**
+		 * Returns the memo slot of a register, resolved at compile time
+		 * @tparam REG the register to look up
+		 * @return the slot, or NUM_MEMOIZED if it is not memoized
+		 */
+		template<typename REG>
+		static constexpr std::size_t memoSlot() {
+			return memoizer::slotOf<REG>(MemoizedRegs());
+		}
+		/**
+		 * Returns the lock stripes covering some registers (or masks),
+		 * and the page registers they're behind
+		 */
+		template<typename ...REGS>
+		static constexpr policy::StripeSet stripesOf() {
+			return (policy::StripeSet(0) | ... | (Lock::stripeOf(RegAddr<Unmask<REGS>>()) | pageStripes<Unmask<REGS>>()));
 		}
-		virtual ~Regmap() = default;
 	protected:
+		~BasicRegmap() = default;
+		template<typename REG>
+		static constexpr policy::StripeSet pageStripes() {
+			if constexpr (isPaged<REG>()) {
+				return Lock::stripeOf(RegAddr<typename REG::PageReg>());
+			}
+			return 0;
+		}
+		DERIVED& device() {
+			return static_cast<DERIVED&>(*this);
+		}
+		/*
+		 * Whether the bus provides deviceReadv/deviceWritev (see bus.h).
+		 * Checked from in here, so a bus can keep them protected and befriend BasicRegmap
+		 */
+		template<typename BUS>
+		static constexpr auto vectored(int) -> decltype(
+			std::declval<BUS&>().deviceReadv(std::declval<const bus::Segment*>(), std::size_t()),
+			std::declval<BUS&>().deviceWritev(std::declval<const bus::Segment*>(), std::size_t()),
+			true) {
+			return true;
+		}
+		template<typename BUS>
+		static constexpr bool vectored(...) {
+			return false;
+		}
+		/*
+		 * Whether the bus provides transferBuffer() (see bus.h)
+		 */
+		template<typename BUS>
+		static constexpr auto buffered(int) -> decltype(
+			std::declval<uint8_t*&>() = std::declval<BUS&>().transferBuffer(std::size_t()), true) {
+			return true;
+		}
+		template<typename BUS>
+		static constexpr bool buffered(...) {
+			return false;
+		}
+		static constexpr std::size_t maxTransfer() {
+			return vectored<DERIVED>(0) ? bus::MAX_VECTORED : bus::MAX_CONTIGUOUS;
+		}
+		template<typename ...REGS>
+		void seedResets(utils::TypeList<REGS...>) {
+			([this] {
+				if constexpr (REGS::hasReset) {
+					constexpr std::size_t IDX = memoSlot<memoizer::Cached<REGS>>();
+					memoized.template update<IDX>(RegType<REGS>(REGS::resetValue));
+				}
+			}(), ...);
+		}
+		template<typename DATA, typename ...REGS>
+		int readGroup(DATA& dest, utils::TypeList<REGS...>) {
+			return readBlock<REGS...>(dest.template get<REGS>()...);
+		}
+		template<typename DATA, typename ...REGS>
+		int writeGroup(DATA& values, utils::TypeList<REGS...>) {
+			return writeBlock<REGS...>(values.template get<REGS>()...);
+		}
+		/*
+		 * Block and group transfers. These expect the caller to hold the lock
+		 */
+		template<typename ...REGS>
+		int readRegs(RegType<REGS>&... dests) {
+			static constexpr auto PLAN = burst::plan<maxTransfer(), REGS...>();
+			static_assert(!PLAN.overlaps, "Registers in a block cannot overlap");
+			static_assert(((RegWidth<REGS>() > 0) && ...), "Commands cannot be read");
+			if constexpr (sizeof...(REGS) == 1) {
+				return readReg<REGS...>(dests...);
+			}
+			else {
+				static_assert((isReadable<REGS>() && ...), "Write-only registers can only be read on their own");
+				static_assert(samePage<REGS...>(), "Registers in a block must be on the same page");
+				constexpr PageSelect SELECT = &BasicRegmap::selectPage<typename utils::Find<IsPaged, void, REGS...>::type>;
+				static constexpr std::size_t SLOTS[] = {memoSlot<REGS>()...};
+				void *destPtrs[] = {&dests...};
+				uint8_t buffer[PLAN.maxRunWidth];
+				bus::Segment segments[sizeof...(REGS) + 1];
+				for(std::size_t r = 0; r < PLAN.numRuns; r++) {
+					int res = readRun(PLAN.runs[r], PLAN.spans, SLOTS, destPtrs, buffer, segments, SELECT);
+					if(res < 0) {
+						return res;
+					}
+				}
+				return 0;
+			}
+		}
+		template<typename ...REGS>
+		int writeRegs(RegType<REGS>... values) {
+			static constexpr auto PLAN = burst::plan<maxTransfer(), REGS...>();
+			static_assert(!PLAN.overlaps, "Registers in a block cannot overlap");
+			static_assert(((RegWidth<REGS>() > 0) && ...), "Use write<CMD>() for commands");
+			static_assert((isWritable<REGS>() && ...), "Read-only registers cannot be written");
+			if constexpr (sizeof...(REGS) == 1) {
+				return writeReg<REGS...>(values...);
+			}
+			else {
+				static_assert(samePage<REGS...>(), "Registers in a block must be on the same page");
+				constexpr PageSelect SELECT = &BasicRegmap::selectPage<typename utils::Find<IsPaged, void, REGS...>::type>;
+				static constexpr std::size_t SLOTS[] = {memoSlot<REGS>()...};
+				void *srcPtrs[] = {&values...};
+				uint8_t buffer[PLAN.maxRunWidth];
+				bus::Segment segments[sizeof...(REGS) + 1];
+				for(std::size_t r = 0; r < PLAN.numRuns; r++) {
+					int res = writeRun(PLAN.runs[r], PLAN.spans, SLOTS, srcPtrs, buffer, segments, SELECT);
+					if(res < 0) {
+						return res;
+					}
+				}
+				return 0;
+			}
+		}
+		template<typename DATA, typename ...REGS>
+		int readGroupRegs(DATA& dest, utils::TypeList<REGS...>) {
+			if constexpr (sizeof...(REGS) == 0) {
+				return 0;
+			}
+			else {
+				return readRegs<REGS...>(dest.template get<REGS>()...);
+			}
+		}
+		template<typename DATA, typename ...REGS>
+		int writeGroupRegs(DATA& values, utils::TypeList<REGS...>) {
+			return writeRegs<REGS...>(values.template get<REGS>()...);
+		}
+		/*
+		 * With policy::FieldValidity, fills in the registers MASKS only partly cover straight from
+		 * the memo, if it knows every bit the masks leave alone.
+		 * Returns whether it did, otherwise they still have to be read
+		 */
+		template<typename ...MASKS, typename DATA, typename ...REGS>
+		bool readKnownBits(DATA& dest, utils::TypeList<REGS...>) {
+			if constexpr (FIELD_VALIDITY && sizeof...(REGS) > 0
+				&& ((memoSlot<REGS>() < NUM_MEMOIZED) && ...)) {
+				if(!(memoized.isKnown(memoSlot<REGS>(), fullBits<REGS>() & ~coveredBits<REGS, MASKS...>()) && ...)) {
+					return false;
+				}
+				((dest.template get<REGS>() = memoized.template slot<memoSlot<REGS>()>()), ...);
+				return true;
+			}
+			return sizeof...(REGS) == 0;
+		}
+		/*
+		 * Fills in the write-only registers that MASKS only partly cover from their shadows
+		 */
+		template<typename ...MASKS, typename DATA, typename ...REGS>
+		void readShadows(DATA& dest, utils::TypeList<REGS...>) {
+			([&] {
+				if constexpr (!isReadable<REGS>() && coveredBits<REGS, MASKS...>() != fullBits<REGS>()) {
+					readShadow<REGS>(dest.template get<REGS>());
+				}
+			}(), ...);
+		}
+		/*
+		 * Write-only registers can't be read back, so the memo shadows them instead.
+		 * Until they're written, their shadow holds their reset value (or 0)
+		 */
+		template<typename REG>
+		void readShadow(RegType<REG>& dest) {
+			constexpr std::size_t IDX = memoSlot<REG>();
+			static_assert(IDX < NUM_MEMOIZED, "Write-only registers must be memoized to be read, or to have their masks written");
+			dest = memoized.isSeen(IDX) ? memoized.template slot<IDX>() : RegType<REG>(REG::resetValue);
+		}
+		/*
+		 * Serves a read straight out of the memo without locking, if policy::SeqlockReads is on
+		 */
+		template<typename REG>
+		bool tryLockFreeRead(RegType<REG>& dest) {
+			constexpr std::size_t IDX = memoSlot<REG>();
+			if constexpr (SEQLOCK_READS && IDX < NUM_MEMOIZED) {
+				return memoized.template tryRead<IDX>(dest);
+			}
+			return false;
+		}
+		/*
+		 * Typed register access, with the memo resolved at compile time.
+		 * These expect the caller to hold the lock
+		 */
+		template<typename REG>
+		int readReg(RegType<REG>& dest) {
+			if constexpr (!isReadable<REG>()) {
+				readShadow<REG>(dest);
+				return 0;
+			}
+			constexpr std::size_t IDX = memoSlot<REG>();
+			if constexpr (IDX < NUM_MEMOIZED) {
+				if(memoized.isSeen(IDX)) {
+					dest = memoized.template slot<IDX>();
+					return 0;
+				}
+			}
+			int r = fetchReg<REG>(dest);
+			if(r < 0) {
+				return r;
+			}
+			if constexpr (IDX < NUM_MEMOIZED) {
+				memoized.template update<IDX>(dest);
+			}
+			return 0;
+		}
+		/*
+		 * readReg() for some bits of a register. With policy::FieldValidity, they're served
+		 * from the memo as long as it knows all of them
+		 */
+		template<typename REG>
+		int readBits(RegType<REG>& dest, RegType<REG> bits) {
+			constexpr std::size_t IDX = memoSlot<REG>();
+			if constexpr (FIELD_VALIDITY && IDX < NUM_MEMOIZED && isReadable<REG>()) {
+				if(memoized.isKnown(IDX, bits)) {
+					dest = memoized.template slot<IDX>();
+					return 0;
+				}
+			}
+			return readReg<REG>(dest);
+		}
+		template<typename REG>
+		int writeReg(RegType<REG> value) {
+			static_assert(isWritable<REG>(), "Read-only registers cannot be written");
+			constexpr std::size_t IDX = memoSlot<REG>();
+			if constexpr (ELIDE_NOOP_WRITES && IDX < NUM_MEMOIZED) {
+				if(memoized.template matches<IDX>(value)) {
+					return 0;
+				}
+			}
+			if constexpr (WRITE_BACK && IDX < NUM_MEMOIZED) {
+				memoized.template update<IDX>(value, true);
+				return 0;
+			}
+			int r = sendReg<REG>(value);
+			if(r < 0) {
+				return r;
+			}
+			if constexpr (IDX < NUM_MEMOIZED) {
+				memoized.template update<IDX>(value);
+			}
+			return 0;
+		}
 		/*
 		 * The following are direct implementations of regmap reading & writing.
 		 * **LOTS OF PITFALLS**, so they're marked protected
-		 * *in the case where num is odd, make sure the void*'s can access num+1 bytes*
+		 * *make sure the void*'s can hold the whole ALU type of num bytes (see alufix::types::aluSize)*
 		 * *when writing, your incoming pointer will be scrambled*
 		 * Beware: No type safety for you
 		 */
 		int directRead(REG_ADDR regAddr, void* dest, std::size_t num) {
-			fixEndianness<ENDIAN, REG_ADDR_WIDTH>(regAddr);
+			Guard guard(*this, Lock::stripeOf(regAddr));
 			auto memoIdx = memoized.getIdx(regAddr);
 			if(memoized.isMemoized(memoIdx) && memoized.isSeen(memoIdx)) {
-				alufix::memcpy(dest, memoized.getPtr(memoIdx), num);
+				alufix::memcpy(dest, memoized.getPtr(memoIdx), alufix::types::aluSize(num));
 				return 0;
 			}
-			auto *destPtr = reinterpret_cast<uint8_t*>(dest);
-			auto r = deviceRead(regAddr, destPtr, num);
+			auto r = fetch(regAddr, dest, num);
 			if(r < 0) {
 				return r;
 			}
-			alufix::toLocalALUFormat<ENDIAN>(destPtr, destPtr, num);
 			if(memoized.isMemoized(memoIdx)) {
-				alufix::memcpy(memoized.getPtr(memoIdx), destPtr, num);
-				memoized.setSeen(memoIdx);
+				memoized.update(memoIdx, dest, num);
 			}
 			return 0;
 		}
 		int directWrite(REG_ADDR regAddr, void* src, std::size_t num) {
-			fixEndianness<ENDIAN, REG_ADDR_WIDTH>(regAddr);
-			uint8_t toSend[num];
-			alufix::toDeviceFormat<ENDIAN>(src, toSend, num);
-			int r = deviceWrite(regAddr, toSend, num);
+			Guard guard(*this, Lock::stripeOf(regAddr));
+			auto memoIdx = memoized.getIdx(regAddr);
+			if constexpr (ELIDE_NOOP_WRITES) {
+				if(num > 0 && memoized.isMemoized(memoIdx) && memoized.matches(memoIdx, src, num)) {
+					return 0;
+				}
+			}
+			if constexpr (WRITE_BACK) {
+				if(num > 0 && memoized.isMemoized(memoIdx)) {
+					memoized.update(memoIdx, src, num, true);
+					return 0;
+				}
+			}
+			int r = send(regAddr, src, num);
 			if(r < 0) {
 				return r;
 			}
-			auto memoIdx = memoized.getIdx(regAddr);
 			if(memoized.isMemoized(memoIdx)) {
-				alufix::memcpy(memoized.getPtr(memoIdx), src, num);
-				memoized.setSeen(memoIdx);
+				memoized.update(memoIdx, src, num);
+			}
+			return 0;
+		}
+		/*
+		 * Bus transactions with endian fixing, but no memoization
+		 */
+		int fetch(REG_ADDR regAddr, void* dest, std::size_t num) {
+			auto *destPtr = reinterpret_cast<uint8_t*>(dest);
+			bus::Segment segments[2] = {{}, {destPtr, num}};
+			auto r = busRead(regAddr, segments, 2, destPtr);
+			if(r < 0) {
+				return r;
+			}
+			alufix::toLocalALUFormat<ENDIAN>(destPtr, destPtr, num);
+			return 0;
+		}
+		/*
+		 * fetch() for a register known at compile time, with the conversion picked statically
+		 */
+		template<typename REG>
+		int fetchReg(RegType<REG> &dest) {
+			constexpr std::size_t WIDTH = RegWidth<REG>();
+			auto *destPtr = reinterpret_cast<uint8_t*>(&dest);
+			bus::Segment segments[2] = {{}, {destPtr, WIDTH}};
+			auto r = selectPage<REG>();
+			if(r < 0) {
+				return r;
+			}
+			r = busRead(RegAddr<REG>(), segments, 2, destPtr);
+			if(r < 0) {
+				return r;
+			}
+			if constexpr (!sameFormat(WIDTH)) {
+				alufix::toLocalALUFormat<ENDIAN, WIDTH>(destPtr, destPtr);
 			}
 			return 0;
 		}
+		int send(REG_ADDR regAddr, void* src, std::size_t num) {
+			if(num > MAX_REG_WIDTH) {
+				return -1;
+			}
+			uint8_t toSend[MAX_REG_WIDTH];
+			uint8_t *packed = packBuffer(num, toSend);
+			alufix::toDeviceFormat<ENDIAN>(src, packed, num);
+			bus::Segment segments[2] = {{}, {packed, num}};
+			return busWrite(regAddr, segments, 2, packed);
+		}
+		/*
+		 * send() for a register known at compile time. Registers already in the device's
+		 * format go out straight from value
+		 */
+		template<typename REG>
+		int sendReg(RegType<REG> &value) {
+			constexpr std::size_t WIDTH = RegWidth<REG>();
+			uint8_t toSend[WIDTH];
+			uint8_t *packed = packBuffer(WIDTH, toSend);
+			if constexpr (zeroCopy(WIDTH)) {
+				packed = reinterpret_cast<uint8_t*>(&value);
+			}
+			else {
+				alufix::toDeviceFormat<ENDIAN, WIDTH>(&value, packed);
+			}
+			bus::Segment segments[2] = {{}, {packed, WIDTH}};
+			int r = selectPage<REG>();
+			if(r < 0) {
+				return r;
+			}
+			return busWrite(RegAddr<REG>(), segments, 2, packed);
+		}
+		using PageSelect = int (BasicRegmap::*)();
+		/*
+		 * Points the page register at REG's page, unless the memo knows it already is.
+		 * Does nothing for registers that aren't paged
+		 */
+		template<typename REG>
+		int selectPage() {
+			if constexpr (isPaged<REG>()) {
+				using PageReg = typename REG::PageReg;
+				constexpr std::size_t IDX = memoSlot<PageReg>();
+				static_assert(IDX < NUM_MEMOIZED, "Page registers must be memoized, so the current page is known");
+				static_assert(!isPaged<PageReg>(), "Page registers cannot be paged themselves");
+				RegType<PageReg> page = REG::page;
+				// a pending write-back of the page register isn't on the device yet
+				if(memoized.template matches<IDX>(page) && !memoized.isDirty(IDX)) {
+					return 0;
+				}
+				int r = sendReg<PageReg>(page);
+				if(r < 0) {
+					return r;
+				}
+				memoized.template update<IDX>(page);
+			}
+			return 0;
+		}
+		/*
+		 * Moves the data segments (segments[1] onwards) over the bus, filling in the address phase.
+		 * Buses without scatter-gather get one contiguous transfer through the buffer, which must
+		 * be able to hold every segment back to back. Segments already sitting at their spot in
+		 * the buffer aren't copied
+		 */
+		int busRead(REG_ADDR regAddr, bus::Segment *segments, std::size_t count, uint8_t *buffer) {
+			fixEndianness<ENDIAN, REG_ADDR_WIDTH>(regAddr);
+			if constexpr (vectored<DERIVED>(0)) {
+				segments[0] = {reinterpret_cast<uint8_t*>(&regAddr), REG_ADDR_WIDTH};
+				return device().deviceReadv(segments, count);
+			}
+			else {
+				std::size_t len = 0;
+				for(std::size_t i = 1; i < count; i++) {
+					len += segments[i].len;
+				}
+				int r = device().deviceRead(regAddr, buffer, len);
+				if(r < 0) {
+					return r;
+				}
+				for(std::size_t i = 1, offset = 0; i < count; offset += segments[i].len, i++) {
+					if(segments[i].data != buffer + offset) {
+						alufix::memcpy(segments[i].data, buffer + offset, segments[i].len);
+					}
+				}
+				return 0;
+			}
+		}
+		int busWrite(REG_ADDR regAddr, bus::Segment *segments, std::size_t count, uint8_t *buffer) {
+			fixEndianness<ENDIAN, REG_ADDR_WIDTH>(regAddr);
+			if constexpr (vectored<DERIVED>(0)) {
+				segments[0] = {reinterpret_cast<uint8_t*>(&regAddr), REG_ADDR_WIDTH};
+				return device().deviceWritev(segments, count);
+			}
+			else if(count == 2 && !buffered<DERIVED>(0)) {
+				// a single segment needs no gathering
+				return device().deviceWrite(regAddr, segments[1].data, segments[1].len);
+			}
+			else {
+				std::size_t len = 0;
+				for(std::size_t i = 1; i < count; i++) {
+					if(segments[i].data != buffer + len) {
+						alufix::memcpy(buffer + len, segments[i].data, segments[i].len);
+					}
+					len += segments[i].len;
+				}
+				return device().deviceWrite(regAddr, buffer, len);
+			}
+		}
+		/*
+		 * Whether a register's device format is byte for byte its local format,
+		 * so it can go over the bus straight from where it lives
+		 */
+		static constexpr bool sameFormat(std::size_t width) {
+			return width == 1 || (ENDIAN == endian::native && alufix::types::aluSize(width) == width);
+		}
+		/*
+		 * Whether a register can be written without packing it anywhere first. Buses with
+		 * their own transfer buffer always want their data in it
+		 */
+		static constexpr bool zeroCopy(std::size_t width) {
+			return sameFormat(width) && !buffered<DERIVED>(0);
+		}
+		/*
+		 * Where to pack len bytes of outgoing data: the bus's own transfer buffer if it has one,
+		 * otherwise the fallback on our stack
+		 */
+		uint8_t *packBuffer(std::size_t len, uint8_t *fallback) {
+			if constexpr (buffered<DERIVED>(0)) {
+				return device().transferBuffer(len);
+			}
+			else {
+				return fallback;
+			}
+		}
+		/*
+		 * Reads one run of a burst plan, skipping the bus if every register is in the memo.
+		 * The run's page is only selected if it does go over the bus
+		 */
+		int readRun(const burst::Run &run, const burst::Span *spans, const std::size_t *slots,
+			void **dests, uint8_t *buffer, bus::Segment *segments, PageSelect select) {
+			bool allSeen = true;
+			for(std::size_t i = run.first; i < run.first + run.count; i++) {
+				auto memoIdx = slots[spans[i].arg];
+				allSeen = allSeen && memoized.isMemoized(memoIdx) && memoized.isSeen(memoIdx);
+			}
+			if(allSeen) {
+				for(std::size_t i = run.first; i < run.first + run.count; i++) {
+					const burst::Span &span = spans[i];
+					alufix::memcpy(dests[span.arg], memoized.getPtr(slots[span.arg]), alufix::types::aluSize(span.width));
+				}
+				return 0;
+			}
+			// land every register straight in its destination, and fix its format in place
+			for(std::size_t i = 0; i < run.count; i++) {
+				const burst::Span &span = spans[run.first + i];
+				segments[i + 1] = {reinterpret_cast<uint8_t*>(dests[span.arg]), span.width};
+			}
+			int r = (this->*select)();
+			if(r < 0) {
+				return r;
+			}
+			r = busRead(run.addr, segments, run.count + 1, buffer);
+			if(r < 0) {
+				return r;
+			}
+			for(std::size_t i = run.first; i < run.first + run.count; i++) {
+				const burst::Span &span = spans[i];
+				auto *destPtr = reinterpret_cast<uint8_t*>(dests[span.arg]);
+				auto memoIdx = slots[span.arg];
+				// the memo wins over the device for registers it already knows,
+				// or pending write-backs would be lost
+				if(memoized.isMemoized(memoIdx) && memoized.isSeen(memoIdx)) {
+					alufix::memcpy(destPtr, memoized.getPtr(memoIdx), alufix::types::aluSize(span.width));
+					continue;
+				}
+				alufix::toLocalALUFormat<ENDIAN>(destPtr, destPtr, span.width);
+				if(memoized.isMemoized(memoIdx)) {
+					memoized.update(memoIdx, destPtr, span.width);
+				}
+			}
+			return 0;
+		}
+		/*
+		 * Writes one run of a burst plan, updating the memo once the bus accepts it.
+		 * In write-back mode, runs made up entirely of memoized registers stay in the memo.
+		 * The run's page is only selected if it does go over the bus
+		 */
+		int writeRun(const burst::Run &planned, const burst::Span *spans, const std::size_t *slots,
+			void **srcs, uint8_t *buffer, bus::Segment *segments, PageSelect select) {
+			burst::Run run = planned;
+			if constexpr (ELIDE_NOOP_WRITES) {
+				// registers at either end of the run that already hold their value don't need sending
+				auto unchanged = [&](std::size_t i) {
+					auto memoIdx = slots[spans[i].arg];
+					return memoized.isMemoized(memoIdx) && memoized.matches(memoIdx, srcs[spans[i].arg], spans[i].width);
+				};
+				while(run.count > 0 && unchanged(run.first)) {
+					run.addr += spans[run.first].width;
+					run.width -= spans[run.first].width;
+					run.first++;
+					run.count--;
+				}
+				while(run.count > 0 && unchanged(run.first + run.count - 1)) {
+					run.width -= spans[run.first + run.count - 1].width;
+					run.count--;
+				}
+				if(run.count == 0) {
+					return 0;
+				}
+			}
+			bool allMemoized = WRITE_BACK;
+			for(std::size_t i = run.first; i < run.first + run.count; i++) {
+				allMemoized = allMemoized && memoized.isMemoized(slots[spans[i].arg]);
+			}
+			if(!allMemoized) {
+				int r = (this->*select)();
+				if(r < 0) {
+					return r;
+				}
+				r = sendRun(run, spans, srcs, buffer, segments);
+				if(r < 0) {
+					return r;
+				}
+			}
+			for(std::size_t i = run.first; i < run.first + run.count; i++) {
+				const burst::Span &span = spans[i];
+				auto memoIdx = slots[span.arg];
+				if(memoized.isMemoized(memoIdx)) {
+					memoized.update(memoIdx, srcs[span.arg], span.width, allMemoized);
+				}
+			}
+			return 0;
+		}
+		/*
+		 * Writes out the memo slots picked by shouldPush in address order, coalescing adjacent
+		 * slots. srcs holds the value to write for each slot, and the memo is updated to match
+		 */
+		template<typename PRED>
+		int pushSlots(PRED shouldPush, void **srcs) {
+			static constexpr auto PLAN = burst::plan<maxTransfer()>(MemoizedRegs());
+			static constexpr auto SLOTS = slotTraits(MemoizedRegs());
+			uint8_t buffer[PLAN.maxRunWidth];
+			bus::Segment segments[NUM_MEMOIZED + 1];
+			// read-only registers are never written back, so runs break around them
+			auto push = [&](std::size_t idx) {
+				return SLOTS.writable[idx] && shouldPush(idx);
+			};
+			for(std::size_t i = 0; i < NUM_MEMOIZED;) {
+				if(!push(PLAN.spans[i].arg)) {
+					i++;
+					continue;
+				}
+				// grow the run for as long as the picked slots stay adjacent
+				burst::Run run{PLAN.spans[i].addr, PLAN.spans[i].width, i, 1};
+				for(std::size_t j = i + 1; j < NUM_MEMOIZED; j++) {
+					const burst::Span &next = PLAN.spans[j];
+					if(!push(next.arg) || next.addr != run.addr + run.width
+						|| run.width + next.width > maxTransfer()
+						|| SLOTS.pages[next.arg] != SLOTS.pages[PLAN.spans[i].arg]) {
+						break;
+					}
+					run.width += next.width;
+					run.count++;
+				}
+				int r = (this->*SLOTS.select[PLAN.spans[i].arg])();
+				if(r < 0) {
+					return r;
+				}
+				r = sendRun(run, PLAN.spans, srcs, buffer, segments);
+				if(r < 0) {
+					return r;
+				}
+				for(std::size_t j = run.first; j < run.first + run.count; j++) {
+					const burst::Span &span = PLAN.spans[j];
+					memoized.update(span.arg, srcs[span.arg], span.width);
+				}
+				i += run.count;
+			}
+			return 0;
+		}
+		/*
+		 * Tells pages apart: the slot of the page register, and the page. 0 for registers that aren't paged
+		 */
+		template<typename REG>
+		static constexpr uint64_t pageId() {
+			if constexpr (isPaged<REG>()) {
+				return (uint64_t(memoSlot<typename REG::PageReg>()) << 32) | (REG::page + 1);
+			}
+			return 0;
+		}
+		/*
+		 * Per memo slot, which page it's on, how to select it and whether it can be written, for pushSlots
+		 */
+		template<std::size_t N>
+		struct SlotTraits {
+			PageSelect select[N];
+			uint64_t pages[N];
+			bool writable[N];
+		};
+		template<typename ...REGS>
+		static constexpr SlotTraits<sizeof...(REGS)> slotTraits(utils::TypeList<REGS...>) {
+			return {{&BasicRegmap::selectPage<REGS>...}, {pageId<REGS>()...}, {isWritable<REGS>()...}};
+		}
+		/*
+		 * Sends one run of a burst plan. Registers that need their bytes shuffled are packed into
+		 * the device's format in the buffer, the rest go out straight from their source
+		 */
+		int sendRun(const burst::Run &run, const burst::Span *spans, void **srcs, uint8_t *buffer,
+			bus::Segment *segments) {
+			buffer = packBuffer(run.width, buffer);
+			for(std::size_t i = 0; i < run.count; i++) {
+				const burst::Span &span = spans[run.first + i];
+				uint8_t *packed = buffer + (span.addr - run.addr);
+				if(zeroCopy(span.width)) {
+					packed = reinterpret_cast<uint8_t*>(srcs[span.arg]);
+				}
+				else {
+					alufix::toDeviceFormat<ENDIAN>(srcs[span.arg], packed, span.width);
+				}
+				segments[i + 1] = {packed, span.width};
+			}
+			return busWrite(run.addr, segments, run.count + 1, buffer);
+		}
+	};
 
+	/**
+	 * A register map whose bus is picked at runtime, by overriding deviceRead/deviceWrite.
+	 * See BasicRegmap for the parameters
+	 */
+	template<endian ENDIAN,
+		typename REG_ADDR,
+		typename... MEMOIZED>
+	class Regmap: public BasicRegmap<Regmap<ENDIAN, REG_ADDR, MEMOIZED...>, ENDIAN, REG_ADDR, MEMOIZED...> {
+		friend BasicRegmap<Regmap, ENDIAN, REG_ADDR, MEMOIZED...>;
+	public:
+		virtual ~Regmap() = default;
+	protected:
 		/*
 		 * The following is for actually performing the transactions
 		 */
@@ -4,6 +4,8 @@
  * them at runtime
  */
 #pragma once
+#include <cstddef>
+#include <type_traits>
 
 namespace regmap::utils {
 	/**
@@ -72,6 +74,72 @@ namespace regmap::utils {
 	template <typename ...Ts>
 	using all_same_types = std::conjunction<std::is_same<GetHead<Ts>,Ts>...>;
 
+	/*
+	 * Type lists
+	 */
+	template<typename ...ITEMS>
+	struct TypeList {
+		static constexpr std::size_t size = sizeof...(ITEMS);
+	};
+
+	// concatenate lists
+	template<typename ...LISTS>
+	struct ConcatImpl {
+		using type = TypeList<>;
+	};
+	template<typename ...A>
+	struct ConcatImpl<TypeList<A...>> {
+		using type = TypeList<A...>;
+	};
+	template<typename ...A, typename ...B, typename ...REST>
+	struct ConcatImpl<TypeList<A...>, TypeList<B...>, REST...> {
+		using type = typename ConcatImpl<TypeList<A..., B...>, REST...>::type;
+	};
+	template<typename ...LISTS>
+	using Concat = typename ConcatImpl<LISTS...>::type;
+
+	// keep the items where PRED<ITEM>::value is true
+	template<template<typename> class PRED, typename ...ITEMS>
+	using Filter = Concat<typename TypeTernary<PRED<ITEMS>::value, TypeList<ITEMS>, TypeList<>>::type...>;
+
+	// instantiate a template with the contents of a list
+	template<template<typename...> class T, typename LIST>
+	struct ApplyImpl;
+	template<template<typename...> class T, typename ...ITEMS>
+	struct ApplyImpl<T, TypeList<ITEMS...>> {
+		using type = T<ITEMS...>;
+	};
+	template<template<typename...> class T, typename LIST>
+	using Apply = typename ApplyImpl<T, LIST>::type;
+
+	// the first item where PRED<ITEM>::value is true, or DEFAULT
+	template<template<typename> class PRED, typename DEFAULT, typename ...ITEMS>
+	struct Find {
+		using type = DEFAULT;
+	};
+	template<template<typename> class PRED, typename DEFAULT, typename HEAD, typename ...REST>
+	struct Find<PRED, DEFAULT, HEAD, REST...> {
+		using type = typename TypeTernary<PRED<HEAD>::value,
+			GetHeadImpl<HEAD>, Find<PRED, DEFAULT, REST...>>::type::type;
+	};
+
+	// whether TARGET is one of ITEMS
+	template<typename TARGET, typename ...ITEMS>
+	using contains = std::disjunction<std::is_same<TARGET, ITEMS>...>;
+
+	// drop repeated items, keeping the first of each
+	template<typename SEEN, typename ...ITEMS>
+	struct UniqueImpl {
+		using type = SEEN;
+	};
+	template<typename ...SEEN, typename HEAD, typename ...REST>
+	struct UniqueImpl<TypeList<SEEN...>, HEAD, REST...> {
+		using type = typename UniqueImpl<typename TypeTernary<contains<HEAD, SEEN...>::value,
+			TypeList<SEEN...>, TypeList<SEEN..., HEAD>>::type, REST...>::type;
+	};
+	template<typename ...ITEMS>
+	using Unique = typename UniqueImpl<TypeList<>, ITEMS...>::type;
+
 }
 namespace regmap {
 	using DeviceAddr = unsigned int;
@@ -1,5 +1,6 @@
 #include "test_common.h"
 #include "doctest.h"
+#include <limits>
 
 TEST_SUITE_BEGIN("regmap");
 
@@ -91,4 +92,697 @@ TEST_CASE("24-bit regs work") {
 	CHECK(value == 0x993456);
 }
 
-TEST_SUITE_END();
\ No newline at end of file
+TEST_CASE("Memoized 24-bit regs fill their whole destination") {
+	TestRegmap map;
+	map.write<ONE_REG>(0x7);
+	map.write<TWENTY_FOUR>(0x123456);
+	uint8_t one;
+	uint32_t value = 0xAAAAAAAA;
+	map.readBlock<ONE_REG, TWENTY_FOUR>(one, value);
+	CHECK(map.bus.readAccesses == 0);
+	CHECK(value == 0x123456);
+}
+
+TEST_CASE("Burst reads coalesce adjacent registers") {
+	TestRegmap map;
+	map.write<WORD_REG>(0x1234);
+	map.write<WORD_REG2>(0x5678);
+	int startReads = map.bus.readAccesses;
+
+	uint16_t word, word2;
+	uint8_t zero, one;
+	CHECK(map.readBlock<WORD_REG2, ZERO_REG, WORD_REG, ONE_REG>(word2, zero, word, one) == 0);
+	// one run for 0x00-0x01, one run for 0x10-0x13
+	CHECK(map.bus.readAccesses - startReads == 2);
+	CHECK(map.bus.lastTransferSize == 4);
+	CHECK(word == 0x1234);
+	CHECK(word2 == 0x5678);
+	CHECK(zero == 2);
+	CHECK(one == 4);
+
+	// ONE_REG is memoized, so it gets served from the cache afterwards
+	startReads = map.bus.readAccesses;
+	map.read<ONE_REG>(one);
+	CHECK(map.bus.readAccesses == startReads);
+	CHECK(one == 4);
+}
+
+TEST_CASE("Burst writes coalesce adjacent registers") {
+	TestRegmap map;
+	int startWrites = map.bus.writeAccesses;
+	CHECK(map.writeBlock<ONE_REG, WORD_REG2, ZERO_REG, WORD_REG>(0x11, 0xBEEF, 0x22, 0xCAFE) == 0);
+	CHECK(map.bus.writeAccesses - startWrites == 2);
+	CHECK(map.bus.lastTransferSize == 4);
+
+	// the memo is updated without touching the bus
+	int startReads = map.bus.readAccesses;
+	uint8_t one;
+	map.read<ONE_REG>(one);
+	CHECK(one == 0x11);
+	CHECK(map.bus.readAccesses == startReads);
+
+	// the device got everything in its own byte order
+	uint16_t word, word2;
+	uint8_t zero;
+	map.read<WORD_REG>(word);
+	map.read<WORD_REG2>(word2);
+	map.read<ZERO_REG>(zero);
+	CHECK(word == 0xCAFE);
+	CHECK(word2 == 0xBEEF);
+	CHECK(zero == 0x22);
+	uint8_t msb;
+	map.read<Reg<0x10, uint8_t>>(msb);
+	CHECK(msb == 0xCA);
+}
+
+TEST_CASE("Write-back mode defers writes until flush") {
+	WriteBackRegmap map;
+	uint8_t tmp;
+	map.read<ZERO_REG>(tmp);
+	map.read<ONE_REG>(tmp);
+	int startReads = map.bus.readAccesses;
+	int startWrites = map.bus.writeAccesses;
+
+	// field writes are served entirely out of the memo
+	map.write<LOW_NIBBLE>(0x9);
+	map.write<HIGH_NIBBLE>(0x6);
+	map.write<MID_NIBBLE>(0x3);
+	map.write<WORD_REG>(0x1234);
+	map.write<WORD_REG2>(0x5678);
+	CHECK(map.bus.readAccesses == startReads);
+	CHECK(map.bus.writeAccesses == startWrites);
+	map.read<ZERO_REG>(tmp);
+	CHECK(tmp == 0x69);
+	CHECK(map.bus.byteMem[0] == 2);
+
+	// 0x00-0x01 and 0x10-0x13 each go out in a single burst
+	CHECK(map.flush() == 0);
+	CHECK(map.bus.writeAccesses - startWrites == 2);
+	CHECK(map.bus.byteMem[0] == 0x69);
+	CHECK(map.bus.byteMem[1] == applyMask<MID_NIBBLE>(4, 0x3));
+	CHECK(map.bus.wordMem[0] == 0x3412);
+
+	// nothing left to flush
+	CHECK(map.flush() == 0);
+	CHECK(map.bus.writeAccesses - startWrites == 2);
+
+	// commands always go straight through
+	map.write<EMPTY_REG>();
+	CHECK(map.bus.writeAccesses - startWrites == 3);
+}
+
+TEST_CASE("Block reads keep pending write-backs") {
+	WriteBackRegmap map;
+	map.write<WORD_REG>(0x1234);
+	uint16_t word, word2;
+	SUBCASE("readBlock") {
+		map.readBlock<WORD_REG, WORD_REG2>(word, word2);
+		CHECK(map.bus.readAccesses == 1);
+		CHECK(word == 0x1234);
+		CHECK(word2 == 0x0400);
+	}
+	SUBCASE("24-bit registers") {
+		using LOW24 = Reg<0x10, uint24_t>;
+		using AFTER24 = Reg<0x13, uint8_t>;
+		DummyRegmap<LOW24, AFTER24, policy::WriteBack> wb;
+		wb.write<LOW24>(0x123456);
+		uint32_t value = 0xAAAAAAAA;
+		uint8_t after;
+		wb.readBlock<LOW24, AFTER24>(value, after);
+		CHECK(wb.bus.readAccesses == 1);
+		CHECK(value == 0x123456);
+	}
+	SUBCASE("masks of several registers") {
+		map.write<WORD_BYTE_L, RegMask<WORD_REG2, 7, 0>>(0x56, 0x78);
+		map.read<WORD_REG>(word);
+		CHECK(word == 0x1256);
+	}
+	// and the value still reaches the device
+	CHECK(map.flush() == 0);
+	map.invalidateAll();
+	map.read<WORD_REG>(word);
+	CHECK((word & 0xFF00) == 0x1200);
+}
+
+TEST_CASE("Invalidating the memo") {
+	TestRegmap map;
+	uint8_t one;
+	uint32_t twentyFour;
+	map.read<ONE_REG>(one);
+	map.read<TWENTY_FOUR>(twentyFour);
+	int startReads = map.bus.readAccesses;
+
+	// the device changed behind our back
+	map.bus.byteMem[1] = 0x42;
+	map.read<ONE_REG>(one);
+	CHECK(one == 4);
+	map.invalidate<MID_NIBBLE>();
+	map.read<ONE_REG>(one);
+	CHECK(one == 0x42);
+	CHECK(map.bus.readAccesses - startReads == 1);
+
+	// everything else stays cached
+	map.read<TWENTY_FOUR>(twentyFour);
+	CHECK(map.bus.readAccesses - startReads == 1);
+
+	// survives the epoch wrapping around
+	constexpr int WRAP = std::numeric_limits<REGMAP_EPOCH_TYPE>::max() + 10;
+	for(int i = 0; i < WRAP; i++) {
+		map.invalidateAll();
+		CHECK(map.memoized.isSeen(0) == false);
+		CHECK(map.memoized.isSeen(1) == false);
+		map.read<ONE_REG>(one);
+		CHECK(map.memoized.isSeen(0) == true);
+	}
+	CHECK(map.bus.readAccesses - startReads == WRAP + 1);
+}
+
+TEST_CASE("Invalidating drops pending write-backs") {
+	WriteBackRegmap map;
+	map.write<WORD_REG>(0x1234);
+	map.write<WORD_REG2>(0x5678);
+	map.invalidate<WORD_REG>();
+	int startWrites = map.bus.writeAccesses;
+	map.flush();
+	CHECK(map.bus.writeAccesses - startWrites == 1);
+	CHECK(map.bus.lastTransferSize == 2);
+
+	map.write<WORD_REG>(0x1234);
+	map.invalidateAll();
+	map.flush();
+	CHECK(map.bus.writeAccesses - startWrites == 1);
+}
+
+TEST_CASE("Ttl registers expire") {
+	TtlRegmap map;
+	FakeClock::ticks = 0xFFF0; // make sure the clock wrapping around is handled
+	uint8_t tmp;
+	map.read<ONE_REG>(tmp);
+	map.read<ZERO_REG>(tmp);
+	int startReads = map.bus.readAccesses;
+
+	FakeClock::ticks += 99;
+	map.read<ONE_REG>(tmp);
+	CHECK(map.bus.readAccesses == startReads);
+
+	// ONE_REG expires, ZERO_REG lives forever
+	FakeClock::ticks += 1;
+	map.read<ONE_REG>(tmp);
+	map.read<ZERO_REG>(tmp);
+	CHECK(map.bus.readAccesses - startReads == 1);
+
+	// writing refreshes the lifetime
+	FakeClock::ticks += 150;
+	map.write<ONE_REG>(0x12);
+	FakeClock::ticks += 50;
+	map.read<ONE_REG>(tmp);
+	CHECK(tmp == 0x12);
+	CHECK(map.bus.readAccesses - startReads == 1);
+}
+
+TEST_CASE("Snapshots restore the device in bursts") {
+	ConfigRegmap map;
+	map.write<ZERO_REG>(0x11);
+	map.write<ONE_REG>(0x22);
+	map.write<WORD_REG>(0x3344);
+	auto snap = map.snapshot();
+
+	// power cycle the device
+	map.bus = DummyBus();
+	map.invalidateAll();
+	CHECK(map.restore(snap) == 0);
+	// 0x00-0x01 go out together, WORD_REG2 was never known so it isn't written
+	CHECK(map.bus.writeAccesses == 2);
+	CHECK(map.bus.byteMem[0] == 0x11);
+	CHECK(map.bus.byteMem[1] == 0x22);
+	CHECK(map.bus.wordMem[0] == 0x4433);
+	CHECK(map.bus.wordMem[1] == 4);
+
+	// the memo is seeded without reading anything back
+	uint8_t zero;
+	uint16_t word;
+	map.read<ZERO_REG>(zero);
+	map.read<WORD_REG>(word);
+	CHECK(zero == 0x11);
+	CHECK(word == 0x3344);
+	CHECK(map.bus.readAccesses == 0);
+	CHECK(map.memoized.isSeen(ConfigRegmap::memoSlot<WORD_REG2>()) == false);
+}
+
+TEST_CASE("Locked regmaps don't race in read-modify-writes") {
+	LockedRegmap map;
+	map.bus.byteMem[0] = 0;
+	std::atomic<bool> go = false;
+	// each thread counts up in its own nibble
+	auto count = [&map, &go](auto writeNibble) {
+		while(!go) {}
+		for(int i = 1; i <= 2000; i++) {
+			writeNibble(map, i & 0xF);
+		}
+	};
+	std::thread low(count, [](LockedRegmap &m, uint8_t v) { m.write<LOW_NIBBLE>(v); });
+	std::thread high(count, [](LockedRegmap &m, uint8_t v) { m.write<HIGH_NIBBLE>(v); });
+	go = true;
+	low.join();
+	high.join();
+	CHECK(map.lostUpdates == 0);
+	CHECK(map.bus.byteMem[0] == 0x00);
+}
+
+TEST_CASE("Statically bound buses behave the same") {
+	StaticRegmap<ONE_REG, WORD_REG> map;
+	uint16_t word;
+	map.write<WORD_REG>(0x1234);
+	map.read<WORD_REG>(word);
+	CHECK(word == 0x1234);
+	CHECK(map.bus.readAccesses == 0);
+
+	uint8_t one, zero;
+	map.write<HIGH_BIT>(1);
+	map.readBlock<ONE_REG, ZERO_REG>(one, zero);
+	CHECK(one == 0x84);
+	CHECK(zero == 2);
+	CHECK(map.bus.readAccesses == 2);
+}
+
+TEST_CASE("Scatter-gather buses get one segment per register") {
+	VectoredRegmap map;
+	map.writeBlock<ONE_REG, ZERO_REG, WORD_REG>(0x22, 0x11, 0x3344);
+	CHECK(map.bus.writeAccesses == 2);
+	CHECK(map.lastSegments == 2);
+	CHECK(map.bus.byteMem[0] == 0x11);
+	CHECK(map.bus.byteMem[1] == 0x22);
+
+	uint16_t word, word2;
+	map.bus.wordMem[1] = 0x6655; // big endian 0x5566
+	map.readBlock<WORD_REG2, WORD_REG>(word2, word);
+	CHECK(map.bus.readAccesses == 1);
+	CHECK(map.lastSegments == 3);
+	CHECK(word == 0x3344);
+	CHECK(word2 == 0x5566);
+
+	uint8_t value;
+	map.read<ZERO_REG>(value);
+	CHECK(value == 0x11);
+	CHECK(map.lastSegments == 2);
+}
+
+TEST_CASE("Writes are packed straight into the bus's buffer") {
+	DmaRegmap map;
+	map.write<ZERO_REG>(0x12);
+	map.write<WORD_REG>(0x3456);
+	map.write<LOW_NIBBLE>(0x7);
+	map.writeBlock<ZERO_REG, ONE_REG, WORD_REG2>(0x9A, 0xBC, 0xDEF0);
+	CHECK(map.strayWrites == 0);
+	CHECK(map.bus.byteMem[0] == 0x9A);
+	CHECK(map.bus.byteMem[1] == 0xBC);
+
+	uint16_t word;
+	map.read<WORD_REG>(word);
+	CHECK(word == 0x3456);
+	map.read<WORD_REG2>(word);
+	CHECK(word == 0xDEF0);
+}
+
+TEST_CASE("Wide registers move in one transaction") {
+	DummyRegmap<TIMESTAMP48> map;
+	uint8_t raw[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+	memcpy(map.bus.wordMem, raw, sizeof(raw));
+
+	uint64_t value;
+	map.read<COUNTER40>(value);
+	CHECK(value == 0x0102030405);
+	CHECK(map.bus.lastTransferSize == 5);
+	map.read<TIMESTAMP48>(value);
+	CHECK(value == 0x010203040506);
+	map.read<ENERGY64>(value);
+	CHECK(value == 0x0102030405060708);
+	CHECK(map.bus.readAccesses == 3);
+
+	map.write<ENERGY64_TOP>(0xFF);
+	map.read<ENERGY64>(value);
+	CHECK(value == 0xFF02030405060708);
+
+	// straight from the memo
+	map.write<TIMESTAMP48>(0xA1A2A3A4A5A6);
+	int reads = map.bus.readAccesses;
+	map.read<TIMESTAMP48>(value);
+	CHECK(value == 0xA1A2A3A4A5A6);
+	CHECK(map.bus.readAccesses == reads);
+	CHECK(memcmp(map.bus.wordMem, "\xA1\xA2\xA3\xA4\xA5\xA6\x07\x08", 8) == 0);
+}
+
+TEST_CASE("Masks of several registers") {
+	DummyRegmap<> map;
+	map.bus.byteMem[0] = 0xAB;
+	map.bus.byteMem[1] = 0xFF;
+	SUBCASE("are read and written in bursts") {
+		map.write<LOW_NIBBLE, MID_NIBBLE>(0x1, 0x0);
+		CHECK(map.bus.readAccesses == 1);
+		CHECK(map.bus.writeAccesses == 1);
+		CHECK(map.bus.lastTransferSize == 2);
+		CHECK(map.bus.byteMem[0] == 0xA1);
+		CHECK(map.bus.byteMem[1] == 0xC3);
+	}
+	SUBCASE("only read registers they partly cover") {
+		map.write<HIGH_BIT, HIGH_NIBBLE, WORD_BYTE_L, LOW_NIBBLE, WORD_BYTE_H>(0, 0x5, 0x22, 0x6, 0x11);
+		// only ONE_REG needs its old value
+		CHECK(map.bus.readAccesses == 1);
+		CHECK(map.bus.writeAccesses == 2);
+		CHECK(map.bus.byteMem[0] == 0x56);
+		CHECK(map.bus.byteMem[1] == 0x7F);
+		uint16_t word;
+		map.read<WORD_REG>(word);
+		CHECK(word == 0x1122);
+	}
+	SUBCASE("with gaps between them still read-modify-write") {
+		map.write<HIGH_BIT, LOW_BIT>(0, 0);
+		CHECK(map.bus.readAccesses == 1);
+		CHECK(map.bus.byteMem[1] == 0x7E);
+	}
+}
+
+TEST_CASE("W1C masks are written without reading") {
+	DummyRegmap<> map;
+	map.bus.byteMem[3] = 0x03;
+	map.write<IRQ_OVERFLOW>(1);
+	CHECK(map.bus.readAccesses == 0);
+	// a read-modify-write would have cleared IRQ_READY too
+	CHECK(map.bus.byteMem[3] == 0x02);
+
+	uint8_t ready, overflow;
+	map.read<IRQ_READY, IRQ_OVERFLOW>(ready, overflow);
+	CHECK(ready == 0);
+	CHECK(overflow == 1);
+	uint8_t id;
+	map.read<CHIP_ID>(id);
+	CHECK(id == 0x02);
+}
+
+TEST_CASE("Restoring skips read-only registers") {
+	DummyRegmap<RO_ID, ONE_REG> map;
+	uint8_t tmp;
+	map.read<RO_ID>(tmp);
+	map.read<ONE_REG>(tmp);
+	auto snap = map.snapshot();
+	map.bus.byteMem[0] = 0x42;
+	CHECK(map.restore(snap) == 0);
+	CHECK(map.bus.writeAccesses == 1);
+	CHECK(map.bus.lastTransferSize == 1);
+	CHECK(map.bus.byteMem[0] == 0x42);
+}
+
+TEST_CASE("Write-only registers are shadowed") {
+	DummyRegmap<ZERO_REG, DAC_CTRL> map;
+	map.write<DAC_GAIN>(0x5);
+	map.write<DAC_ENABLE>(1);
+	CHECK(map.bus.readAccesses == 0);
+	CHECK(map.bus.writeAccesses == 2);
+	CHECK(map.bus.byteMem[2] == 0x51);
+
+	uint8_t ctrl, gain;
+	map.read<DAC_CTRL>(ctrl);
+	map.read<DAC_GAIN>(gain);
+	CHECK(map.bus.readAccesses == 0);
+	CHECK(ctrl == 0x51);
+	CHECK(gain == 0x5);
+
+	// alongside readable registers, only those get read
+	map.write<LOW_NIBBLE, DAC_ENABLE>(0x3, 0);
+	CHECK(map.bus.readAccesses == 1);
+	CHECK(map.bus.byteMem[0] == 0x03);
+	CHECK(map.bus.byteMem[2] == 0x50);
+}
+
+TEST_CASE("Assuming a reset seeds the memo") {
+	DummyRegmap<CONFIG, THRESHOLD, WORD_REG> map;
+	map.assumeReset();
+	map.write<CONFIG_MODE>(0x2);
+	CHECK(map.bus.readAccesses == 0);
+	CHECK(map.bus.byteMem[1] == 0xF2);
+
+	uint16_t threshold, word;
+	map.read<THRESHOLD>(threshold);
+	CHECK(map.bus.readAccesses == 0);
+	CHECK(threshold == 0x1234);
+	// no reset value, so it still comes from the device
+	map.read<WORD_REG>(word);
+	CHECK(map.bus.readAccesses == 1);
+}
+
+TEST_CASE("Field validity tracks masks on their own") {
+	FieldRegmap map;
+	uint8_t low, high;
+	map.read<ZERO_REG>(low);
+	CHECK(map.bus.readAccesses == 1);
+	map.invalidate<HIGH_NIBBLE>();
+	SUBCASE("reads of known masks stay in the memo") {
+		map.read<LOW_NIBBLE>(low);
+		CHECK(map.bus.readAccesses == 1);
+		CHECK(low == 0x2);
+		map.read<HIGH_NIBBLE>(high);
+		CHECK(map.bus.readAccesses == 2);
+		map.read<LOW_NIBBLE, HIGH_NIBBLE>(low, high);
+		CHECK(map.bus.readAccesses == 2);
+	}
+	SUBCASE("writes don't need the bits they replace") {
+		map.write<HIGH_NIBBLE>(0xA);
+		CHECK(map.bus.readAccesses == 1);
+		CHECK(map.bus.byteMem[0] == 0xA2);
+		map.invalidate<LOW_NIBBLE>();
+		map.write<LOW_NIBBLE>(0x5);
+		CHECK(map.bus.readAccesses == 1);
+		CHECK(map.bus.byteMem[0] == 0xA5);
+		map.invalidate<HIGH_NIBBLE>();
+		map.write<LOW_NIBBLE>(0x6);
+		CHECK(map.bus.readAccesses == 2);
+	}
+	SUBCASE("pending write-backs are forgotten as a whole") {
+		DummyRegmap<ZERO_REG, policy::WriteBack, policy::FieldValidity> wb;
+		wb.read<ZERO_REG>(low);
+		wb.write<HIGH_NIBBLE>(0xA);
+		wb.invalidate<LOW_NIBBLE>();
+		CHECK(wb.flush() == 0);
+		CHECK(wb.bus.writeAccesses == 0);
+		wb.read<HIGH_NIBBLE>(high);
+		CHECK(wb.bus.readAccesses == 2);
+		CHECK(high == 0x0);
+	}
+	SUBCASE("whole registers are still forgotten as a whole") {
+		map.invalidate<ZERO_REG>();
+		map.read<LOW_NIBBLE>(low);
+		CHECK(map.bus.readAccesses == 2);
+	}
+}
+
+TEST_CASE("Paged registers select their page") {
+	uint8_t ctrl0, ctrl1, status;
+	SUBCASE("only when it changes") {
+		PagedRegmap<> map;
+		map.bus.byteMem[3] = 0;
+		map.read<BANK1_CTRL>(ctrl1);
+		map.read<BANK1_STATUS>(status);
+		CHECK(map.pageWrites == 1);
+		map.read<BANK0_CTRL>(ctrl0);
+		CHECK(map.pageWrites == 2);
+		CHECK(ctrl0 == 0x10);
+		CHECK(ctrl1 == 0x20);
+		CHECK(status == 0x21);
+		// same address, different slots
+		map.read<BANK1_CTRL>(ctrl1);
+		CHECK(map.bus.readAccesses == 3);
+		CHECK(ctrl1 == 0x20);
+		CHECK(map.memoSlot<BANK0_CTRL>() != map.memoSlot<BANK1_CTRL>());
+		// untyped lookups only see unpaged registers
+		CHECK(map.memoized.getIdx(0) == 4);
+		CHECK(map.memoized.getIdx(3) == 0);
+
+		map.write<BANK1_MODE>(0x5);
+		CHECK(map.pageWrites == 3);
+		CHECK(map.banks[1][0] == 0x25);
+	}
+	SUBCASE("once per block") {
+		PagedRegmap<> map;
+		map.readBlock<BANK1_CTRL, BANK1_STATUS>(ctrl1, status);
+		CHECK(map.pageWrites == 1);
+		CHECK(map.bus.readAccesses == 1);
+		CHECK(status == 0x21);
+		// the page only changes for blocks that go over the bus
+		map.read<BANK0_CTRL>(ctrl0);
+		map.readBlock<BANK1_CTRL, BANK1_STATUS>(ctrl1, status);
+		CHECK(map.pageWrites == 2);
+		CHECK(map.bus.readAccesses == 2);
+	}
+	SUBCASE("not for blocks that stay in the memo") {
+		PagedRegmap<policy::WriteBack> map;
+		map.bus.byteMem[3] = 0;
+		map.writeBlock<BANK1_CTRL, BANK1_STATUS>(0x30, 0x31);
+		CHECK(map.pageWrites == 0);
+		CHECK(map.bus.writeAccesses == 0);
+	}
+	SUBCASE("when flushing") {
+		PagedRegmap<policy::WriteBack> map;
+		map.bus.byteMem[3] = 0;
+		map.write<BANK1_STATUS>(0x31);
+		map.write<BANK0_CTRL>(0x40);
+		map.write<BANK1_CTRL>(0x30);
+		CHECK(map.pageWrites == 0);
+		CHECK(map.flush() == 0);
+		CHECK(map.banks[0][0] == 0x40);
+		CHECK(map.banks[1][0] == 0x30);
+		CHECK(map.banks[1][1] == 0x31);
+		// bank 1 goes out as one burst
+		CHECK(map.bus.writeAccesses == 2 + map.pageWrites);
+	}
+}
+
+TEST_CASE("No-op writes are elided") {
+	ElidingRegmap map;
+	map.write<ZERO_REG>(0x12);
+	map.write<ZERO_REG>(0x12);
+	CHECK(map.bus.writeAccesses == 1);
+
+	// the memo has to know the value first
+	map.write<LOW_BIT>(1);
+	CHECK(map.bus.readAccesses == 1);
+	CHECK(map.bus.writeAccesses == 2);
+	map.write<LOW_BIT>(1);
+	CHECK(map.bus.writeAccesses == 2);
+	map.write<HIGH_NIBBLE, MID_NIBBLE>(2, 3);
+	CHECK(map.bus.writeAccesses == 3);
+	map.write<HIGH_NIBBLE, MID_NIBBLE>(2, 3);
+	CHECK(map.bus.writeAccesses == 3);
+	CHECK(map.bus.byteMem[1] == 0x0D);
+
+	// unchanged registers at the ends of a burst are trimmed off
+	map.writeBlock<ZERO_REG, ONE_REG>(0x12, 0x0D);
+	CHECK(map.bus.writeAccesses == 4);
+	CHECK(map.bus.lastTransferSize == 1);
+	map.writeBlock<ZERO_REG, ONE_REG>(0x12, 0x0D);
+	CHECK(map.bus.writeAccesses == 4);
+
+	// an invalidated memo can't vouch for the device
+	map.invalidate<ZERO_REG>();
+	map.write<ZERO_REG>(0x12);
+	CHECK(map.bus.writeAccesses == 5);
+
+	// unmemoized registers always go out
+	map.write<TWENTY_FOUR>(1);
+	map.write<TWENTY_FOUR>(1);
+	CHECK(map.bus.writeAccesses == 7);
+}
+
+TEST_CASE("Register groups") {
+	ConfigRegmap map;
+	GroupType<WORDS> words;
+	words.get<WORD_REG>() = 0x1234;
+	words.get<WORD_REG2>() = 0x5678;
+	map.write<WORDS>(words);
+	CHECK(map.bus.writeAccesses == 1);
+	CHECK(map.bus.lastTransferSize == 4);
+
+	DummyRegmap<> uncached;
+	uncached.bus = map.bus;
+	GroupType<MIXED> mixed;
+	uncached.read<MIXED>(mixed);
+	// the bytes and the word aren't adjacent
+	CHECK(uncached.bus.readAccesses == 2);
+	CHECK(mixed.get<ZERO_REG>() == 2);
+	CHECK(mixed.get<ONE_REG>() == 4);
+	CHECK(mixed.get<WORD_REG>() == 0x1234);
+
+	// everything comes out of the memo
+	words = {};
+	map.read<WORDS>(words);
+	CHECK(map.bus.readAccesses == 0);
+	CHECK(words.get<WORD_REG2>() == 0x5678);
+}
+
+TEST_CASE("Draining FIFOs") {
+	FifoRegmap map;
+	SUBCASE("16-bit samples") {
+		uint16_t storage[200];
+		fifo::Ring<uint16_t> ring(storage);
+		map.level = 100;
+		CHECK(map.drainFifo<FIFO_DATA, FIFO_LEVEL>(ring) == 100);
+		// 200 bytes fit in a single burst
+		CHECK(map.fifoReads == 1);
+		CHECK(ring.size == 100);
+		CHECK(ring[0] == 0x0001);
+		CHECK(ring[99] == 0xC6C7);
+
+		// wraps around the end of the ring, capped by the space left
+		ring.pop(90);
+		map.level = 127;
+		CHECK(map.drainFifo<FIFO_DATA, FIFO_LEVEL>(ring) == 127);
+		CHECK(map.fifoReads == 3);
+		CHECK(ring.size == 137);
+		CHECK(ring[10] == 0xC8C9);
+		CHECK(ring[136] == uint16_t(((2 * 226) & 0xFF) << 8 | ((2 * 226 + 1) & 0xFF)));
+	}
+	SUBCASE("rings without capacity stay empty") {
+		fifo::Ring<uint16_t> ring(nullptr, 0);
+		map.level = 10;
+		CHECK(map.drainFifo<FIFO_DATA, FIFO_LEVEL>(ring) == 0);
+		CHECK(map.fifoReads == 0);
+		CHECK(ring.head() == 0);
+	}
+	SUBCASE("bursts respect the bus's limit") {
+		uint16_t storage[300];
+		fifo::Ring<uint16_t> ring(storage);
+		map.level = 127;
+		map.drainFifo<FIFO_DATA, FIFO_LEVEL>(ring);
+		map.level = 127;
+		map.drainFifo<FIFO_DATA, FIFO_LEVEL>(ring);
+		CHECK(ring.size == 254);
+		CHECK(map.maxFifoRead <= 255);
+		for(std::size_t i = 0; i < ring.size; i++) {
+			CHECK(ring[i] == uint16_t(((2 * i) & 0xFF) << 8 | ((2 * i + 1) & 0xFF)));
+		}
+	}
+	SUBCASE("24-bit samples") {
+		uint32_t storage[40];
+		fifo::Ring<uint32_t> ring(storage);
+		map.level = 40;
+		CHECK(map.drainFifo<FIFO24_DATA, FIFO_LEVEL>(ring) == 40);
+		CHECK(map.fifoReads == 1);
+		for(std::size_t i = 0; i < ring.size; i++) {
+			CHECK(ring[i] == (uint32_t(3 * i) << 16 | uint32_t(3 * i + 1) << 8 | uint32_t(3 * i + 2)));
+		}
+	}
+}
+
+TEST_CASE("Seqlock reads never block") {
+	SeqlockRegmap map;
+	map.write<WORD_REG>(0x1111);
+
+	// memoized reads go around the lock
+	map.holdLock();
+	uint16_t word = 0;
+	uint16_t high = 0;
+	map.read<WORD_REG>(word);
+	map.read<WORD_BYTE_H>(high);
+	map.releaseLock();
+	CHECK(word == 0x1111);
+	CHECK(high == 0x11);
+
+	// and never see a half-written value
+	std::atomic<bool> done = false;
+	int torn = 0;
+	std::thread reader([&map, &done, &torn] {
+		while(!done) {
+			uint16_t value;
+			map.read<WORD_REG>(value);
+			torn += (value >> 8) != (value & 0xFF);
+		}
+	});
+	for(uint16_t i = 0; i < 2000; i++) {
+		map.write<WORD_REG>((i & 0xFF) * 0x0101);
+		std::this_thread::yield();
+	}
+	done = true;
+	reader.join();
+	CHECK(torn == 0);
+}
+
+TEST_SUITE_END();
@@ -1,5 +1,6 @@
 #include "test_common.h"
 #include <type_traits>
+#include <utility>
 
 /*
  * Because we've abused constexpr, most tests can be
@@ -31,4 +32,63 @@ static_assert(MaskL<MaskMerge1>() == 2, "mask merge");
 using MaskMerge2 = MergeMasks<HIGH_BIT, MID_NIBBLE, LOW_BIT>;
 static_assert(std::is_same<RegOf<MaskMerge2>, ONE_REG>::value, "mask merge");
 static_assert(MaskH<MaskMerge2>() == 7, "mask merge");
-static_assert(MaskL<MaskMerge2>() == 0, "mask merge");
\ No newline at end of file
+static_assert(MaskL<MaskMerge2>() == 0, "mask merge");
+
+/* wide registers */
+static_assert(alufix::constSwaps::bswap64(0x0102030405060708) == 0x0807060504030201, "wide registers");
+static_assert(alufix::constSwaps::bswap32(0x80000001) == 0x01000080, "wide registers");
+static_assert(bitmask<ENERGY64_ALL>() == ~uint64_t(0), "wide registers");
+static_assert(bitmask<ENERGY64_TOP>() == 0xFF00000000000000, "wide registers");
+static_assert(MaskSpansRegister<ENERGY64_ALL>(), "wide registers");
+static_assert(MaskSpansRegister<RegMask<TWENTY_FOUR, 23, 0>>(), "wide registers");
+static_assert(sizeof(RegType<COUNTER40>) == 8, "wide registers");
+
+/* check memo slots are resolved at compile time */
+static_assert(TestRegmap::memoSlot<ONE_REG>() == 0, "memo slots");
+static_assert(TestRegmap::memoSlot<TWENTY_FOUR>() == 1, "memo slots");
+static_assert(TestRegmap::memoSlot<ZERO_REG>() == TestRegmap::NUM_MEMOIZED, "memo slots");
+static_assert(WriteBackRegmap::memoSlot<WORD_REG2>() == 3, "memo slots");
+static_assert(!TestRegmap::isMemoized<WORD_REG>(), "memo slots");
+static_assert(TtlRegmap::memoSlot<ONE_REG>() == 1, "memo slots");
+
+/* timestamps are only kept for Ttl registers */
+static_assert(sizeof(memoizer::NMemoizer<ONE_REG, policy::Clock<FakeClock>>)
+	== sizeof(memoizer::NMemoizer<ONE_REG>), "ttl storage");
+
+/* the default lock is free */
+static_assert(sizeof(DummyRegmap<ONE_REG>) == sizeof(DummyRegmap<ONE_REG, policy::NoLock>), "locks");
+static_assert(policy::StripedLock<4>::ALL_STRIPES == 0xF, "locks");
+static_assert(policy::StripedLock<32>::ALL_STRIPES == 0xFFFFFFFF, "locks");
+static_assert(DummyRegmap<ONE_REG, policy::StripedLock<4>>::stripesOf<ONE_REG, WORD_REG, LOW_NIBBLE>() == 0b11, "locks");
+
+/* statically bound buses don't drag a vtable around */
+static_assert(!std::is_polymorphic<StaticRegmap<ONE_REG>>::value, "static bus");
+static_assert(sizeof(StaticRegmap<ONE_REG>) < sizeof(DummyRegmap<ONE_REG>), "static bus");
+
+/* groups are plain structs */
+static_assert(sizeof(GroupType<WORDS>) == 2 * sizeof(uint16_t), "groups");
+static_assert(std::is_trivially_copyable_v<GroupType<MIXED>>, "groups");
+
+/* access semantics come from the register */
+static_assert(RegAccess<ONE_REG>() == Access::RW, "access");
+static_assert(RegAccess<IRQ_READY>() == Access::W1C, "access");
+static_assert(!isWritable<CHIP_ID>() && isReadable<CHIP_ID>(), "access");
+static_assert(isReadable<SAMPLE_POP>() && !isReadable<DAC_CTRL>(), "access");
+static_assert(!isCacheable<IRQ_STATUS>() && !isCacheable<SAMPLE_POP>() && isCacheable<CHIP_ID>(), "access");
+
+/* reset values are optional */
+static_assert(CONFIG::hasReset && CONFIG::resetValue == 0xF0, "reset");
+static_assert(!ONE_REG::hasReset && std::is_same_v<ONE_REG, Reg<1, uint8_t, Access::RW>>, "reset");
+
+/* big maps don't hit the constexpr recursion limit */
+template<typename SEQ>
+struct BigMap;
+template<std::size_t... I>
+struct BigMap<std::index_sequence<I...>> {
+	using type = DummyRegmap<Reg<I * 2, uint16_t>...>;
+};
+using BigRegmap = BigMap<std::make_index_sequence<600>>::type;
+static_assert(sizeof(BigRegmap) > 600 * sizeof(uint16_t), "big maps");
+static_assert(BigRegmap::memoSlot<Reg<1198, uint16_t>>() == 599, "big maps");
+static_assert(BigRegmap::Memo::OFFSETS.offsets[599] == 599 * sizeof(uint16_t), "big maps");
+static_assert(memoizer::AddrIndex<Reg<0, uint8_t>, Reg<1198, uint16_t>>::lookup(1198) == 1, "big maps");
@@ -2,6 +2,8 @@
 #include <cstdint>
 #include <regmap/regmap.h>
 #include <cstring>
+#include <mutex>
+#include <thread>
 
 using namespace regmap;
 
@@ -9,7 +11,12 @@ DECLR_BYTE(ZERO_REG, 0)
 DECLR_BYTE(ONE_REG, 1)
 DECLR_CMD(EMPTY_REG, 2)
 DECLR_REG(WORD_REG, 0x10, uint16_t)
+DECLR_REG(WORD_REG2, 0x12, uint16_t)
 DECLR_REG(TWENTY_FOUR, 0x24, uint24_t)
+// wide counters, sharing the word registers' memory
+DECLR_REG(COUNTER40, 0x10, uint40_t)
+DECLR_REG(TIMESTAMP48, 0x10, uint48_t)
+DECLR_REG(ENERGY64, 0x10, uint64_t)
 
 /* Define test register masks */
 DECLR_MASK(WORD_BYTE_H, WORD_REG, 15, 8)
@@ -24,10 +31,31 @@ DECLR_MASK(HIGH_BIT, ONE_REG, 7, 7);
 
 DECLR_MASK(TWENTY_FOUR_HIGH, TWENTY_FOUR, 23, 16)
 
+DECLR_GROUP(WORDS, WORD_REG2, WORD_REG)
+DECLR_GROUP(MIXED, ONE_REG, WORD_REG, ZERO_REG)
+DECLR_MASK(ENERGY64_TOP, ENERGY64, 63, 56)
+DECLR_MASK(ENERGY64_ALL, ENERGY64, 63, 0)
+
+// byteMem[3] seen through different access semantics
+DECLR_BYTE(IRQ_STATUS, 3, regmap::Access::W1C)
+DECLR_BYTE(CHIP_ID, 3, regmap::Access::RO)
+DECLR_BYTE(SAMPLE_POP, 3, regmap::Access::COR)
+DECLR_BYTE(RO_ID, 0, regmap::Access::RO)
+DECLR_MASK(IRQ_READY, IRQ_STATUS, 0, 0)
+DECLR_MASK(IRQ_OVERFLOW, IRQ_STATUS, 1, 1)
+DECLR_BYTE(DAC_CTRL, 2, regmap::Access::WO)
+DECLR_MASK(DAC_GAIN, DAC_CTRL, 7, 4)
+DECLR_MASK(DAC_ENABLE, DAC_CTRL, 0, 0)
+// byteMem[1] and wordMem[1], with reset values from the "datasheet"
+DECLR_BYTE(CONFIG, 1, regmap::Access::RW, 0xF0)
+DECLR_MASK(CONFIG_MODE, CONFIG, 1, 0)
+DECLR_REG(THRESHOLD, 0x12, uint16_t, regmap::Access::RW, 0x1234)
+
 class DummyBus {
 public:
 	int readAccesses = 0;
 	int writeAccesses = 0;
+	int lastTransferSize = 0;
 	uint8_t byteMem[4] = {2, 4, 6, 8};
 	uint16_t wordMem[4] = {2, 4, 6, 8};
 	uint24_t twentyFourMem;
@@ -52,6 +80,7 @@ public:
 		}
 		memcpy(dest, reg, num);
 		readAccesses++;
+		lastTransferSize = num;
 		return 0;
 	}
 	int write(uint8_t regAddr, uint8_t *src, uint8_t num) {
@@ -61,12 +90,14 @@ public:
 		}
 		memcpy(reg, src, num);
 		writeAccesses++;
+		lastTransferSize = num;
 		return 0;
 	}
 	~DummyBus() = default;
 };
 
-class TestRegmap: public Regmap<endian::big, uint8_t, ONE_REG, TWENTY_FOUR> {
+template<typename ...MEMOIZED>
+class DummyRegmap: public Regmap<endian::big, uint8_t, MEMOIZED...> {
 public:
 	DummyBus bus;
 
@@ -77,4 +108,175 @@ public:
 	int deviceWrite(uint8_t regAddr, uint8_t *src, uint8_t num) override {
 		return bus.write(regAddr, src, num);
 	}
+};
+
+template<typename ...MEMOIZED>
+class StaticRegmap: public BasicRegmap<StaticRegmap<MEMOIZED...>, endian::big, uint8_t, MEMOIZED...> {
+	friend BasicRegmap<StaticRegmap, endian::big, uint8_t, MEMOIZED...>;
+public:
+	DummyBus bus;
+protected:
+	int deviceRead(uint8_t regAddr, uint8_t *src, uint8_t num) {
+		return bus.read(regAddr, src, num);
+	}
+	int deviceWrite(uint8_t regAddr, uint8_t *src, uint8_t num) {
+		return bus.write(regAddr, src, num);
+	}
+};
+
+// a bus that takes descriptor chains, on top of the same memory
+class VectoredRegmap: public BasicRegmap<VectoredRegmap, endian::big, uint8_t, ONE_REG> {
+public:
+	DummyBus bus;
+	std::size_t lastSegments = 0;
+
+	int deviceRead(uint8_t regAddr, uint8_t *src, uint8_t num) {
+		return bus.read(regAddr, src, num);
+	}
+	int deviceWrite(uint8_t regAddr, uint8_t *src, uint8_t num) {
+		return bus.write(regAddr, src, num);
+	}
+	int deviceReadv(const bus::Segment *segments, std::size_t count) {
+		uint8_t *mem = bus.resolveAddr(segments[0].data[0]);
+		for(std::size_t i = 1; i < count; mem += segments[i].len, i++) {
+			memcpy(segments[i].data, mem, segments[i].len);
+		}
+		bus.readAccesses++;
+		lastSegments = count;
+		return 0;
+	}
+	int deviceWritev(const bus::Segment *segments, std::size_t count) {
+		uint8_t *mem = bus.resolveAddr(segments[0].data[0]);
+		for(std::size_t i = 1; i < count; mem += segments[i].len, i++) {
+			memcpy(mem, segments[i].data, segments[i].len);
+		}
+		bus.writeAccesses++;
+		lastSegments = count;
+		return 0;
+	}
+};
+
+// a bus that can only send out of its own DMA buffer
+class DmaRegmap: public BasicRegmap<DmaRegmap, endian::big, uint8_t, WORD_REG> {
+public:
+	DummyBus bus;
+	uint8_t dma[8];
+	int strayWrites = 0;
+
+	uint8_t *transferBuffer(std::size_t len) {
+		return dma;
+	}
+	int deviceRead(uint8_t regAddr, uint8_t *src, uint8_t num) {
+		return bus.read(regAddr, src, num);
+	}
+	int deviceWrite(uint8_t regAddr, uint8_t *src, uint8_t num) {
+		strayWrites += src != dma;
+		return bus.write(regAddr, src, num);
+	}
+};
+
+DECLR_REG(FIFO_DATA, 0x30, uint16_t)
+DECLR_REG(FIFO24_DATA, 0x31, uint24_t)
+DECLR_BYTE(FIFO_STATUS, 0x32)
+DECLR_MASK(FIFO_LEVEL, FIFO_STATUS, 6, 0)
+
+// a device streaming out a counting sequence of samples
+class FifoRegmap: public DummyRegmap<> {
+public:
+	uint8_t level = 0;
+	uint8_t nextByte = 0;
+	int fifoReads = 0;
+	int maxFifoRead = 0;
+
+	int deviceRead(uint8_t regAddr, uint8_t *src, uint8_t num) override {
+		if(regAddr == FIFO_STATUS::addr) {
+			*src = level | 0x80;
+			return 0;
+		}
+		for(uint8_t i = 0; i < num; i++) {
+			src[i] = nextByte++;
+		}
+		fifoReads++;
+		maxFifoRead = num > maxFifoRead ? num : maxFifoRead;
+		return 0;
+	}
+};
+
+struct FakeClock {
+	static inline uint16_t ticks = 0;
+	static uint16_t now() {
+		return ticks;
+	}
+};
+
+using TestRegmap = DummyRegmap<ONE_REG, TWENTY_FOUR>;
+using WriteBackRegmap = DummyRegmap<ZERO_REG, ONE_REG, WORD_REG, WORD_REG2, policy::WriteBack>;
+using TtlRegmap = DummyRegmap<ZERO_REG, Ttl<ONE_REG, 100>, policy::Clock<FakeClock>>;
+using ConfigRegmap = DummyRegmap<ZERO_REG, ONE_REG, WORD_REG, WORD_REG2>;
+using ElidingRegmap = DummyRegmap<ZERO_REG, ONE_REG, WORD_REG, WORD_REG2, policy::ElideNoopWrites>;
+using FieldRegmap = DummyRegmap<ZERO_REG, ONE_REG, policy::FieldValidity>;
+
+DECLR_BYTE(PAGE_SEL, 3)
+DECLR_PAGED(BANK0_CTRL, PAGE_SEL, 0, 0, uint8_t)
+DECLR_PAGED(BANK1_CTRL, PAGE_SEL, 1, 0, uint8_t)
+DECLR_PAGED(BANK1_STATUS, PAGE_SEL, 1, 1, uint8_t)
+DECLR_MASK(BANK1_MODE, BANK1_CTRL, 3, 0)
+
+// addresses 0 and 1 are a window onto whichever bank PAGE_SEL (byteMem[3]) picks
+template<typename ...POLICIES>
+class PagedRegmap: public DummyRegmap<PAGE_SEL, BANK0_CTRL, BANK1_CTRL, BANK1_STATUS, POLICIES...> {
+public:
+	uint8_t banks[2][2] = {{0x10, 0x11}, {0x20, 0x21}};
+	int pageWrites = 0;
+
+	int deviceRead(uint8_t regAddr, uint8_t *dest, uint8_t num) override {
+		if(regAddr < 2) {
+			memcpy(dest, &banks[this->bus.byteMem[3]][regAddr], num);
+			this->bus.readAccesses++;
+			return 0;
+		}
+		return this->bus.read(regAddr, dest, num);
+	}
+	int deviceWrite(uint8_t regAddr, uint8_t *src, uint8_t num) override {
+		if(regAddr < 2) {
+			memcpy(&banks[this->bus.byteMem[3]][regAddr], src, num);
+			this->bus.writeAccesses++;
+			return 0;
+		}
+		pageWrites += regAddr == 3;
+		return this->bus.write(regAddr, src, num);
+	}
+};
+
+template<typename LOCK>
+class SlowRegmap: public DummyRegmap<LOCK> {
+public:
+	// how often a nibble of ZERO_REG went backwards, which only happens if an update was lost
+	int lostUpdates = 0;
+
+	// give other threads a chance to get in the middle of a read-modify-write
+	int deviceRead(uint8_t regAddr, uint8_t *src, uint8_t num) override {
+		int r = this->bus.read(regAddr, src, num);
+		std::this_thread::yield();
+		return r;
+	}
+	int deviceWrite(uint8_t regAddr, uint8_t *src, uint8_t num) override {
+		uint8_t old = this->bus.byteMem[0];
+		uint8_t lowStep = (src[0] - old) & 0xF;
+		uint8_t highStep = ((src[0] >> 4) - (old >> 4)) & 0xF;
+		lostUpdates += lowStep > 1 || highStep > 1;
+		return this->bus.write(regAddr, src, num);
+	}
+};
+using LockedRegmap = SlowRegmap<policy::BusLock<std::mutex>>;
+
+class SeqlockRegmap: public DummyRegmap<WORD_REG, policy::SeqlockReads, policy::BusLock<std::mutex>> {
+public:
+	// pretend to be a writer stuck in the middle of a slow transaction
+	void holdLock() {
+		lockStripes(Lock::ALL_STRIPES);
+	}
+	void releaseLock() {
+		unlockStripes(Lock::ALL_STRIPES);
+	}
 };
\ No newline at end of file
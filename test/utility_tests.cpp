@@ -1,5 +1,6 @@
 #include "doctest.h"
 #include "test_common.h"
+#include <regmap/alufix_bulk.h>
 
 TEST_SUITE_BEGIN("Utilities");
 
@@ -36,6 +37,108 @@ TEST_CASE("Bitmasks work correctly") {
 		CHECK(MaskSpansRegister<MaskMerged>());
 	}
 }
+TEST_CASE("Conversion kernels handle unaligned pointers") {
+	// odd offsets into a buffer, so nothing lines up
+	uint8_t machine[17] = {0};
+	uint8_t alu[17] = {0};
+	SUBCASE("Big endian") {
+		uint64_t value = 0x0000A1B2C3D4E5F6;
+		alufix::toDeviceFormat<endian::big, 6>(&value, machine + 1);
+		CHECK(machine[1] == 0xA1);
+		CHECK(machine[6] == 0xF6);
+		alufix::toLocalALUFormat<endian::big, 6>(alu + 3, machine + 1);
+		uint64_t back;
+		memcpy(&back, alu + 3, sizeof(back));
+		CHECK(back == value);
+
+		uint32_t triple = 0x00123456;
+		alufix::toDeviceFormat<endian::big, 3>(&triple, machine + 9);
+		CHECK(machine[9] == 0x12);
+		CHECK(machine[11] == 0x56);
+	}
+	SUBCASE("Little endian") {
+		uint16_t word = 0x1234;
+		alufix::toDeviceFormat<endian::little, 2>(&word, machine + 1);
+		CHECK(machine[1] == 0x34);
+		CHECK(machine[2] == 0x12);
+		// in place
+		alufix::toLocalALUFormat<endian::little, 2>(machine + 1, machine + 1);
+		uint16_t back;
+		memcpy(&back, machine + 1, sizeof(back));
+		CHECK(back == word);
+	}
+	SUBCASE("Runtime widths agree") {
+		uint64_t value = 0x0102030405060708;
+		alufix::toDeviceFormat<endian::big>(&value, machine + 1, 8);
+		alufix::toDeviceFormat<endian::big, 8>(&value, alu + 1);
+		CHECK(memcmp(machine + 1, alu + 1, 8) == 0);
+		CHECK(machine[1] == 0x01);
+		CHECK(machine[8] == 0x08);
+	}
+}
+TEST_CASE("Bulk conversions match the scalar kernels") {
+	// enough samples for a few vectors and a ragged tail, starting off alignment
+	constexpr std::size_t COUNT = 37;
+	uint8_t raw[COUNT * 4 + 1];
+	for(std::size_t i = 0; i < sizeof(raw); i++) {
+		raw[i] = uint8_t(i * 37 + 11);
+	}
+	uint8_t *src = raw + 1;
+
+	SUBCASE("16-bit") {
+		uint16_t bulk[COUNT], scalar[COUNT];
+		alufix::bulk::toLocal16<endian::big>(bulk, src, COUNT);
+		alufix::bulk::detail::toLocalScalar<endian::big, 2>(scalar, src, COUNT);
+		CHECK(memcmp(bulk, scalar, sizeof(bulk)) == 0);
+		CHECK(bulk[0] == ((src[0] << 8) | src[1]));
+		alufix::bulk::toLocal16<endian::little>(bulk, src, COUNT);
+		CHECK(bulk[COUNT - 1] == ((src[COUNT * 2 - 1] << 8) | src[COUNT * 2 - 2]));
+	}
+	SUBCASE("32-bit") {
+		uint32_t bulk[COUNT], scalar[COUNT];
+		alufix::bulk::toLocal32<endian::big>(bulk, src, COUNT);
+		alufix::bulk::detail::toLocalScalar<endian::big, 4>(scalar, src, COUNT);
+		CHECK(memcmp(bulk, scalar, sizeof(bulk)) == 0);
+	}
+	SUBCASE("24-bit, sign extended") {
+		int32_t bulk[COUNT], scalar[COUNT];
+		alufix::bulk::toLocal24<endian::big>(bulk, src, COUNT);
+		alufix::bulk::detail::toLocalScalar<endian::big, 3>(scalar, src, COUNT);
+		CHECK(memcmp(bulk, scalar, sizeof(bulk)) == 0);
+		alufix::bulk::toLocal24<endian::little>(bulk, src, COUNT);
+		alufix::bulk::detail::toLocalScalar<endian::little, 3>(scalar, src, COUNT);
+		CHECK(memcmp(bulk, scalar, sizeof(bulk)) == 0);
+
+		uint8_t samples[] = {0xFF, 0xFF, 0xFE, 0x7F, 0xFF, 0xFF, 0x80, 0x00, 0x00};
+		alufix::bulk::toLocal24<endian::big>(bulk, samples, 3);
+		CHECK(bulk[0] == -2);
+		CHECK(bulk[1] == 0x7FFFFF);
+		CHECK(bulk[2] == -0x800000);
+	}
+	SUBCASE("24-bit, zero extended") {
+		uint32_t bulk[COUNT], scalar[COUNT];
+		alufix::bulk::toLocal24<endian::big>(bulk, src, COUNT);
+		alufix::bulk::detail::toLocalScalar<endian::big, 3>(scalar, src, COUNT);
+		CHECK(memcmp(bulk, scalar, sizeof(bulk)) == 0);
+		CHECK(bulk[0] == uint32_t((src[0] << 16) | (src[1] << 8) | src[2]));
+	}
+#ifdef ALUFIX_X86_SIMD
+	SUBCASE("SSSE3 on AVX2 machines too") {
+		if(alufix::bulk::detail::hasSSSE3()) {
+			int32_t bulk[COUNT], scalar[COUNT];
+			std::size_t done = alufix::bulk::detail::spread24SSSE3<endian::big, true>(
+				reinterpret_cast<uint8_t*>(bulk), src, COUNT);
+			alufix::bulk::detail::toLocalScalar<endian::big, 3>(scalar, src, COUNT);
+			CHECK(memcmp(bulk, scalar, done * sizeof(int32_t)) == 0);
+
+			uint16_t words[COUNT], scalarWords[COUNT];
+			done = alufix::bulk::detail::swapSSSE3<2>(reinterpret_cast<uint8_t*>(words), src, COUNT);
+			alufix::bulk::detail::toLocalScalar<endian::big, 2>(scalarWords, src, COUNT);
+			CHECK(memcmp(words, scalarWords, done * sizeof(uint16_t)) == 0);
+		}
+	}
+#endif
+}
 TEST_CASE("Bitsets work correctly") {
 	bitset<10> bits = {0};
 	CHECK(bitset_test(bits, 3) == false);
@@ -44,4 +147,31 @@ TEST_CASE("Bitsets work correctly") {
 	CHECK(bitset_test(bits, 8) == true);
 }
 
+TEST_CASE("Memo address lookups") {
+	SUBCASE("Small address spaces use a dense table") {
+		memoizer::NMemoizer<WORD_REG, ZERO_REG, TWENTY_FOUR> memo;
+		CHECK(memo.getIdx(0x10) == 0);
+		CHECK(memo.getIdx(0x00) == 1);
+		CHECK(memo.getIdx(0x24) == 2);
+		CHECK(memo.getIdx(0x01) == 3);
+		CHECK(memo.getIdx(0x1000) == 3);
+		CHECK(memo.getPtr(2) == &memo.slot<2>());
+		CHECK(memo.getPtr(3) == nullptr);
+	}
+	SUBCASE("Sparse address spaces use a binary search") {
+		using Sparse = memoizer::NMemoizer<Reg<0x8000, uint32_t>, Reg<0x40, uint8_t>,
+			Reg<0x1234, uint16_t>, Reg<0x10000, uint8_t>>;
+		static_assert(std::is_same_v<memoizer::AddrIndex<Reg<0x8000, uint32_t>, Reg<0x40, uint8_t>>,
+			memoizer::SortedIndex<Reg<0x8000, uint32_t>, Reg<0x40, uint8_t>>>);
+		Sparse memo;
+		CHECK(memo.getIdx(0x8000) == 0);
+		CHECK(memo.getIdx(0x40) == 1);
+		CHECK(memo.getIdx(0x1234) == 2);
+		CHECK(memo.getIdx(0x10000) == 3);
+		CHECK(memo.getIdx(0x41) == 4);
+		CHECK(memo.getIdx(0) == 4);
+		CHECK(memo.getPtr(1) == &memo.slot<1>());
+	}
+}
+
 TEST_SUITE_END();
\ No newline at end of file